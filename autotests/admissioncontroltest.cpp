@@ -0,0 +1,193 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    autotests/admissioncontroltest.cpp
+
+    This file is part of Kleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "uiserver/admissioncontrol.h"
+
+#include "settings.h"
+
+#include <QStandardPaths>
+#include <QTest>
+
+#include <vector>
+
+using namespace Kleo;
+
+namespace
+{
+void setMaxRunningCommands(int max)
+{
+    Settings settings;
+    settings.setMaxRunningCommands(max);
+    settings.save();
+}
+}
+
+class AdmissionControlTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void init()
+    {
+        setMaxRunningCommands(2);
+    }
+
+    void cleanup()
+    {
+        // let the queued retries of a test run before the next test starts
+        QCoreApplication::processEvents();
+        QCOMPARE(AdmissionControl::instance()->runningCommands(), 0u);
+        QCOMPARE(AdmissionControl::instance()->waitingCommands(), 0u);
+    }
+
+    void testAdmitsUpToTheLimit()
+    {
+        AdmissionControl *const control = AdmissionControl::instance();
+        const int a = 0, b = 0, c = 0;
+        int retries = 0;
+        const auto retry = [&retries]() {
+            ++retries;
+        };
+
+        AdmissionControl::Ticket ticketA = control->admit(&a, retry);
+        AdmissionControl::Ticket ticketB = control->admit(&b, retry);
+        QVERIFY(ticketA);
+        QVERIFY(ticketB);
+        QCOMPARE(control->runningCommands(), 2u);
+
+        AdmissionControl::Ticket ticketC = control->admit(&c, retry);
+        QVERIFY(!ticketC);
+        QCOMPARE(control->waitingCommands(), 1u);
+
+        // asking again does not queue the waiter twice
+        QVERIFY(!control->admit(&c, retry));
+        QCOMPARE(control->waitingCommands(), 1u);
+
+        ticketA.reset();
+        QCOMPARE(control->runningCommands(), 1u);
+        // the slot is reserved for the waiter, and the retry is queued
+        QCOMPARE(control->waitingCommands(), 1u);
+        QCOMPARE(retries, 0);
+        QCoreApplication::processEvents();
+        QCOMPARE(retries, 1);
+
+        ticketC = control->admit(&c, retry);
+        QVERIFY(ticketC);
+        QCOMPARE(control->runningCommands(), 2u);
+        QCOMPARE(control->waitingCommands(), 0u);
+    }
+
+    void testReservedSlotIsNotTakenByNewcomers()
+    {
+        AdmissionControl *const control = AdmissionControl::instance();
+        const int a = 0, b = 0, c = 0, d = 0;
+        const auto noop = []() { };
+
+        AdmissionControl::Ticket ticketA = control->admit(&a, noop);
+        AdmissionControl::Ticket ticketB = control->admit(&b, noop);
+        QVERIFY(!control->admit(&c, noop));
+
+        ticketA.reset();
+        // the free slot belongs to c
+        QVERIFY(!control->admit(&d, noop));
+        QCOMPARE(control->waitingCommands(), 2u);
+
+        AdmissionControl::Ticket ticketC = control->admit(&c, noop);
+        QVERIFY(ticketC);
+        QCOMPARE(control->waitingCommands(), 1u);
+
+        ticketB.reset();
+        AdmissionControl::Ticket ticketD = control->admit(&d, noop);
+        QVERIFY(ticketD);
+    }
+
+    void testWaitersAreAdmittedInOrder()
+    {
+        AdmissionControl *const control = AdmissionControl::instance();
+        const int a = 0, b = 0, c = 0, d = 0;
+        std::vector<const void *> order;
+        const auto retryFor = [&order](const void *waiter) {
+            return [&order, waiter]() {
+                order.push_back(waiter);
+            };
+        };
+
+        AdmissionControl::Ticket ticketA = control->admit(&a, retryFor(&a));
+        AdmissionControl::Ticket ticketB = control->admit(&b, retryFor(&b));
+        QVERIFY(!control->admit(&c, retryFor(&c)));
+        QVERIFY(!control->admit(&d, retryFor(&d)));
+
+        ticketA.reset();
+        ticketB.reset();
+        QCoreApplication::processEvents();
+        // only one slot is reserved at a time
+        QCOMPARE(order, std::vector<const void *>({&c}));
+
+        AdmissionControl::Ticket ticketC = control->admit(&c, retryFor(&c));
+        QVERIFY(ticketC);
+        QCoreApplication::processEvents();
+        QCOMPARE(order, std::vector<const void *>({&c, &d}));
+
+        AdmissionControl::Ticket ticketD = control->admit(&d, retryFor(&d));
+        QVERIFY(ticketD);
+    }
+
+    void testCancelPassesOnTheReservation()
+    {
+        AdmissionControl *const control = AdmissionControl::instance();
+        const int a = 0, b = 0, c = 0, d = 0;
+        bool retriedC = false;
+        bool retriedD = false;
+
+        AdmissionControl::Ticket ticketA = control->admit(&a, []() { });
+        AdmissionControl::Ticket ticketB = control->admit(&b, []() { });
+        QVERIFY(!control->admit(&c, [&retriedC]() {
+            retriedC = true;
+        }));
+        QVERIFY(!control->admit(&d, [&retriedD]() {
+            retriedD = true;
+        }));
+
+        ticketA.reset();
+        // c's client has gone away before the retry
+        control->cancel(&c);
+        QCOMPARE(control->waitingCommands(), 1u);
+        QCoreApplication::processEvents();
+        QVERIFY(retriedC); // the retry had already been queued
+        QVERIFY(retriedD);
+
+        QVERIFY(!control->admit(&c, []() { }));
+        control->cancel(&c);
+        AdmissionControl::Ticket ticketD = control->admit(&d, []() { });
+        QVERIFY(ticketD);
+    }
+
+    void testUnlimited()
+    {
+        setMaxRunningCommands(0);
+
+        AdmissionControl *const control = AdmissionControl::instance();
+        const int waiters[10] = {};
+        std::vector<AdmissionControl::Ticket> tickets;
+        for (const int &waiter : waiters) {
+            tickets.push_back(control->admit(&waiter, []() { }));
+            QVERIFY(tickets.back());
+        }
+        QCOMPARE(control->runningCommands(), 10u);
+        QCOMPARE(control->waitingCommands(), 0u);
+    }
+};
+
+QTEST_MAIN(AdmissionControlTest)
+#include "admissioncontroltest.moc"
@@ -0,0 +1,148 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    autotests/copyfiletest.cpp
+
+    This file is part of Kleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "utils/path-helper.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace Kleo;
+
+namespace
+{
+bool writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+QByteArray testData(int size)
+{
+    QByteArray data;
+    data.reserve(size);
+    for (int i = 0; i < size; ++i) {
+        data.push_back(char((i * 7) % 251));
+    }
+    return data;
+}
+}
+
+class CopyFileTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init()
+    {
+        QVERIFY(tmpDir.isValid());
+    }
+
+    void testCopyFile_data()
+    {
+        QTest::addColumn<QByteArray>("data");
+
+        QTest::newRow("empty") << QByteArray();
+        QTest::newRow("small") << QByteArray("Hello, World!\n");
+        QTest::newRow("large") << testData(3 * 1024 * 1024 + 17);
+    }
+
+    void testCopyFile()
+    {
+        QFETCH(QByteArray, data);
+
+        const QString src = tmpDir.filePath(QStringLiteral("src"));
+        const QString dest = tmpDir.filePath(QStringLiteral("dest"));
+        QVERIFY(writeFile(src, data));
+
+        QVERIFY(copyFile(src, dest));
+        QCOMPARE(readFile(dest), data);
+        QCOMPARE(readFile(src), data);
+
+        QVERIFY(QFile::remove(src));
+        QVERIFY(QFile::remove(dest));
+    }
+
+    void testCopyFileKeepsPermissions()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("script"));
+        const QString dest = tmpDir.filePath(QStringLiteral("script-copy"));
+        QVERIFY(writeFile(src, "#!/bin/sh\n"));
+        const QFile::Permissions permissions = QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner | QFile::ReadUser | QFile::WriteUser | QFile::ExeUser;
+        QVERIFY(QFile::setPermissions(src, permissions));
+
+        QVERIFY(copyFile(src, dest));
+        QCOMPARE(QFile::permissions(dest), permissions);
+    }
+
+    void testCopyFileDoesNotOverwrite()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("new"));
+        const QString dest = tmpDir.filePath(QStringLiteral("existing"));
+        QVERIFY(writeFile(src, "new"));
+        QVERIFY(writeFile(dest, "existing"));
+
+        QVERIFY(!copyFile(src, dest));
+        QCOMPARE(readFile(dest), QByteArray("existing"));
+    }
+
+    void testCopyFileWithMissingSource()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("missing"));
+        const QString dest = tmpDir.filePath(QStringLiteral("missing-copy"));
+
+        QVERIFY(!copyFile(src, dest));
+        QVERIFY(!QFile::exists(dest));
+    }
+
+    void testReplaceFile()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("replacement"));
+        const QString dest = tmpDir.filePath(QStringLiteral("replaced"));
+        QVERIFY(writeFile(src, "new contents"));
+        QVERIFY(writeFile(dest, "old contents"));
+
+        QVERIFY(replaceFile(src, dest));
+        QCOMPARE(readFile(dest), QByteArray("new contents"));
+        QVERIFY(!QFile::exists(src));
+    }
+
+    void testReplaceFileWithoutDestination()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("moved"));
+        const QString dest = tmpDir.filePath(QStringLiteral("moved-here"));
+        QVERIFY(writeFile(src, "contents"));
+
+        QVERIFY(replaceFile(src, dest));
+        QCOMPARE(readFile(dest), QByteArray("contents"));
+        QVERIFY(!QFile::exists(src));
+    }
+
+    void testReplaceFileWithMissingSource()
+    {
+        const QString src = tmpDir.filePath(QStringLiteral("gone"));
+        const QString dest = tmpDir.filePath(QStringLiteral("kept"));
+        QVERIFY(writeFile(dest, "kept contents"));
+
+        QVERIFY(!replaceFile(src, dest));
+        QCOMPARE(readFile(dest), QByteArray("kept contents"));
+    }
+
+private:
+    QTemporaryDir tmpDir;
+};
+
+QTEST_MAIN(CopyFileTest)
+#include "copyfiletest.moc"
@@ -0,0 +1,179 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    autotests/keysearchindextest.cpp
+
+    This file is part of Kleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "utils/keysearchindex.h"
+
+#include <Libkleo/KeyCache>
+
+#include <QStandardPaths>
+#include <QTest>
+
+#include <gpgme++/key.h>
+
+#include <gpgme.h>
+
+#include <cstring>
+
+using namespace Kleo;
+
+namespace
+{
+GpgME::Key createTestKey(const char *uid, const char *fingerprint)
+{
+    gpgme_key_t key;
+    gpgme_key_from_uid(&key, uid);
+    Q_ASSERT(key);
+    key->protocol = GPGME_PROTOCOL_OpenPGP;
+    key->fpr = strdup(fingerprint);
+    return GpgME::Key(key, false);
+}
+}
+
+class KeySearchIndexTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+
+        alice = createTestKey("Alice Example <alice@example.com>", "0123456789ABCDEF0123456789ABCDEF01234567");
+        bob = createTestKey("Bob Builder <bob@example.net>", "FEDCBA9876543210FEDCBA9876543210FEDCBA98");
+        carol = createTestKey("Carol Alison <carol@example.org>", "1111222233334444555566667777888899990000");
+        KeyCache::mutableInstance()->setKeys({alice, bob, carol});
+    }
+
+    void testEmptyQueryMatchesAll()
+    {
+        const auto result = KeySearchIndex::instance()->search(QString());
+        QVERIFY(result->contains(alice));
+        QVERIFY(result->contains(bob));
+        QVERIFY(result->contains(carol));
+    }
+
+    void testShortQueries()
+    {
+        // shorter than a trigram, so all certificates are checked
+        auto result = KeySearchIndex::instance()->search(QStringLiteral("b"));
+        QVERIFY(result->contains(alice)); // ...abcdef... in the fingerprint
+        QVERIFY(result->contains(bob));
+        QVERIFY(!result->contains(carol));
+
+        result = KeySearchIndex::instance()->search(QStringLiteral("Zq"));
+        QVERIFY(!result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(!result->contains(carol));
+    }
+
+    void testSearchIsCaseInsensitive()
+    {
+        const auto result = KeySearchIndex::instance()->search(QStringLiteral("ALICE@EXAMPLE"));
+        QVERIFY(result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(!result->contains(carol));
+    }
+
+    void testRefinement()
+    {
+        auto result = KeySearchIndex::instance()->search(QStringLiteral("ali"));
+        QVERIFY(result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(result->contains(carol));
+
+        // extends the previous query, so only its matches are checked
+        result = KeySearchIndex::instance()->search(QStringLiteral("alic"));
+        QVERIFY(result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(!result->contains(carol));
+
+        // no longer an extension of the previous query
+        result = KeySearchIndex::instance()->search(QStringLiteral("al"));
+        QVERIFY(result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(result->contains(carol));
+
+        result = KeySearchIndex::instance()->search(QStringLiteral("bob"));
+        QVERIFY(!result->contains(alice));
+        QVERIFY(result->contains(bob));
+        QVERIFY(!result->contains(carol));
+    }
+
+    void testRepeatedQueryReturnsSameResult()
+    {
+        const auto result = KeySearchIndex::instance()->search(QStringLiteral("example"));
+        QVERIFY(KeySearchIndex::instance()->search(QStringLiteral("Example")) == result);
+    }
+
+    void testFingerprintGroups()
+    {
+        // the fingerprint is indexed without the grouping spaces
+        auto result = KeySearchIndex::instance()->search(QStringLiteral("0123 4567 89AB CDEF"));
+        QVERIFY(result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(!result->contains(carol));
+
+        result = KeySearchIndex::instance()->search(QStringLiteral("fedcba98 76543210"));
+        QVERIFY(!result->contains(alice));
+        QVERIFY(result->contains(bob));
+        QVERIFY(!result->contains(carol));
+    }
+
+    void testKeyIdSuffix()
+    {
+        // a key ID with grouping spaces is only found via the end of the fingerprint
+        auto result = KeySearchIndex::instance()->search(QStringLiteral("7777 8888 9999 0000"));
+        QVERIFY(!result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(result->contains(carol));
+
+        // short key ID
+        result = KeySearchIndex::instance()->search(QStringLiteral("99990000"));
+        QVERIFY(!result->contains(alice));
+        QVERIFY(!result->contains(bob));
+        QVERIFY(result->contains(carol));
+    }
+
+    void testKeysNotInTheIndex()
+    {
+        const GpgME::Key eve = createTestKey("Eve Alias <eve@example.com>", "EEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEEE");
+        const auto result = KeySearchIndex::instance()->search(QStringLiteral("alias"));
+        QVERIFY(result->contains(eve));
+        QVERIFY(!result->contains(alice));
+    }
+
+    void testRebuildAfterInvalidation()
+    {
+        const auto before = KeySearchIndex::instance()->search(QStringLiteral("ali"));
+        QVERIFY(before->contains(carol));
+
+        const GpgME::Key dave = createTestKey("Dave Alias <dave@example.com>", "2222333344445555666677778888999900001111");
+        KeyCache::mutableInstance()->insert(dave);
+
+        // the earlier result of the same query must not be reused
+        const auto after = KeySearchIndex::instance()->search(QStringLiteral("ali"));
+        QVERIFY(after != before);
+        QVERIFY(after->contains(alice));
+        QVERIFY(!after->contains(bob));
+        QVERIFY(after->contains(carol));
+        QVERIFY(after->contains(dave));
+
+        const auto byKeyId = KeySearchIndex::instance()->search(QStringLiteral("9999 0000 1111"));
+        QVERIFY(byKeyId->contains(dave));
+        QVERIFY(!byKeyId->contains(carol));
+    }
+
+private:
+    GpgME::Key alice;
+    GpgME::Key bob;
+    GpgME::Key carol;
+};
+
+QTEST_MAIN(KeySearchIndexTest)
+#include "keysearchindextest.moc"
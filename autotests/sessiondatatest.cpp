@@ -0,0 +1,170 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    autotests/sessiondatatest.cpp
+
+    This file is part of Kleopatra's test suite.
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include "uiserver/sessiondata.h"
+
+#include "settings.h"
+
+#include <QStandardPaths>
+#include <QTest>
+
+using namespace Kleo;
+
+namespace
+{
+class TestMemento : public AssuanCommand::Memento
+{
+public:
+    explicit TestMemento(qint64 size)
+        : m_size(size)
+    {
+    }
+
+    qint64 estimatedSize() const override
+    {
+        return m_size;
+    }
+
+private:
+    qint64 m_size;
+};
+
+void setLimits(int idleTimeout, int maxIdleSessions, int maxCacheSize)
+{
+    Settings settings;
+    settings.setSessionIdleTimeout(idleTimeout);
+    settings.setMaxIdleSessions(maxIdleSessions);
+    settings.setMaxSessionCacheSize(maxCacheSize);
+    settings.save();
+}
+
+void addSession(unsigned int id, qint64 size, bool idle = true)
+{
+    const auto handler = SessionDataHandler::instance();
+    handler->enterSession(id);
+    handler->sessionData(id)->mementos["test"] = std::make_shared<TestMemento>(size);
+    if (idle) {
+        handler->exitSession(id);
+    }
+}
+
+bool hasSession(unsigned int id)
+{
+    return !!SessionDataHandler::instance()->memento(id, "test");
+}
+
+void collectGarbage()
+{
+    // the slot locks the handler itself
+    SessionDataHandler *const handler = SessionDataHandler::instance().get();
+    QMetaObject::invokeMethod(handler, "slotCollectGarbage");
+}
+}
+
+class SessionDataTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+    }
+
+    void init()
+    {
+        setLimits(120, 0, 0);
+    }
+
+    void cleanup()
+    {
+        // run the garbage collections queued by exitSession() before clearing
+        QCoreApplication::processEvents();
+        SessionDataHandler::instance()->clear();
+    }
+
+    void testMementosAreKept()
+    {
+        addSession(1, 100);
+        collectGarbage();
+        QVERIFY(hasSession(1));
+        QVERIFY(!SessionDataHandler::instance()->memento(1, "other"));
+        QVERIFY(!SessionDataHandler::instance()->memento(2, "test"));
+        QVERIFY(SessionDataHandler::instance()->dumpStatistics().contains(" hits=1 misses=2 "));
+    }
+
+    void testLeastRecentlyUsedSessionsAreEvicted()
+    {
+        addSession(1, 100);
+        QTest::qWait(20);
+        addSession(2, 100);
+        QTest::qWait(20);
+        addSession(3, 100);
+        QTest::qWait(20);
+        // using session 1 makes session 2 the least recently used one
+        QVERIFY(SessionDataHandler::instance()->sessionData(1));
+
+        setLimits(120, 2, 0);
+        collectGarbage();
+        QVERIFY(hasSession(1));
+        QVERIFY(!hasSession(2));
+        QVERIFY(hasSession(3));
+    }
+
+    void testMemoryLimit()
+    {
+        setLimits(120, 0, 1024);
+        addSession(1, 600 * 1024);
+        QTest::qWait(20);
+        addSession(2, 600 * 1024);
+        collectGarbage();
+        QVERIFY(!hasSession(1));
+        QVERIFY(hasSession(2));
+
+        // a single session above the limit is dropped, too
+        addSession(3, 2048 * 1024);
+        collectGarbage();
+        QVERIFY(!hasSession(2));
+        QVERIFY(!hasSession(3));
+    }
+
+    void testSessionsInUseAreNeverDropped()
+    {
+        setLimits(1, 1, 1);
+        addSession(1, 2048 * 1024, /*idle=*/false);
+        addSession(2, 100, /*idle=*/false);
+        QTest::qWait(1100);
+        collectGarbage();
+        QVERIFY(hasSession(1));
+        QVERIFY(hasSession(2));
+        QVERIFY(SessionDataHandler::instance()->dumpStatistics().startsWith("sessions active=2 idle=0 "));
+
+        SessionDataHandler::instance()->exitSession(1);
+        SessionDataHandler::instance()->exitSession(2);
+    }
+
+    void testIdleSessionsExpire()
+    {
+        setLimits(1, 0, 0);
+        addSession(1, 100);
+        QTest::qWait(600);
+        addSession(2, 100);
+        QTest::qWait(600);
+        collectGarbage();
+        QVERIFY(!hasSession(1));
+        QVERIFY(hasSession(2));
+
+        QTest::qWait(1100);
+        collectGarbage();
+        QVERIFY(!hasSession(2));
+    }
+};
+
+QTEST_MAIN(SessionDataTest)
+#include "sessiondatatest.moc"
@@ -39,3 +39,12 @@
 
 /* Defined if GpgME++ supports setting the curve when generating ECC card keys */
 #cmakedefine GPGMEPP_SUPPORTS_SET_CURVE 1
+
+/* Defined if posix_fadvise is available */
+#cmakedefine HAVE_POSIX_FADVISE 1
+
+/* Defined if fallocate is available */
+#cmakedefine HAVE_FALLOCATE 1
+
+/* Defined if copy_file_range is available */
+#cmakedefine HAVE_COPY_FILE_RANGE 1
@@ -12,7 +12,8 @@
 #include "changeroottrustcommand.h"
 #include "command_p.h"
 
-#include <Libkleo/KeyCache>
+#include <utils/keycachereconciler.h>
+
 #include <Libkleo/Dn>
 #include <Libkleo/GnuPG>
 
@@ -69,9 +70,9 @@ private:
 private:
     void slotOperationFinished()
     {
-        KeyCache::mutableInstance()->enableFileSystemWatcher(true);
+        KeyCacheReconciler::enableFileSystemWatcher(true);
         if (error.isEmpty()) {
-            KeyCache::mutableInstance()->reload(GpgME::CMS);
+            KeyCacheReconciler::reloadKeyCache(GpgME::CMS);
         } else
             Command::Private::error(i18n("Failed to update the trust database:\n"
                                          "%1", error),
@@ -172,7 +173,7 @@ void ChangeRootTrustCommand::doStart()
     }
 
     d->gpgConfPath = gpgConfPath();
-    KeyCache::mutableInstance()->enableFileSystemWatcher(false);
+    KeyCacheReconciler::enableFileSystemWatcher(false);
     d->start();
 }
 
@@ -17,6 +17,7 @@
 #include "importcertificatescommand_p.h"
 
 #include "certifycertificatecommand.h"
+#include <utils/keycachereconciler.h>
 #include <utils/keys.h>
 #include <utils/memory-helpers.h>
 #include <settings.h>
@@ -750,7 +751,7 @@ void ImportCertificatesCommand::Private::tryToFinish()
         auto keyCache = KeyCache::mutableInstance();
         keyListConnection = connect(keyCache.get(), &KeyCache::keyListingDone,
                                     q, [this]() { keyCacheUpdated(); });
-        keyCache->startKeyListing();
+        KeyCacheReconciler::reloadKeyCache();
     }
 }
 
@@ -19,8 +19,6 @@
 #include <QGpgME/ImportJob>
 #include <QGpgME/ExportJob>
 
-#include <Libkleo/KeyCache>
-
 #include <KLocalizedString>
 #include <KMessageBox>
 
@@ -30,6 +28,8 @@
 #include "kleopatra_debug.h"
 #include "command_p.h"
 
+#include <utils/keycachereconciler.h>
+
 using namespace Kleo;
 using namespace Kleo::Commands;
 using namespace GpgME;
@@ -140,7 +140,7 @@ void ImportPaperKeyCommand::postSuccessHook(QWidget *)
     }
 
     // Refresh the key after success
-    KeyCache::mutableInstance()->reload(OpenPGP);
+    KeyCacheReconciler::reloadKeyCache(OpenPGP);
     Q_EMIT finished();
     d->information(xi18nc("@info", "Successfully restored the secret key parts from <filename>%1</filename>",
                    mFileName));
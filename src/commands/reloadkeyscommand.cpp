@@ -13,6 +13,8 @@
 #include "smartcard/readerstatus.h"
 #include "command_p.h"
 
+#include <utils/keycachereconciler.h>
+
 #include <Libkleo/KeyCache>
 
 #include "kleopatra_debug.h"
@@ -86,7 +88,7 @@ void ReloadKeysCommand::doStart()
         d->keyListingDone(result);
     });
 
-    KeyCache::mutableInstance()->startKeyListing();
+    KeyCacheReconciler::reloadKeyCache();
 }
 
 void ReloadKeysCommand::doCancel()
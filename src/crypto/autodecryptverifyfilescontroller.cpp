@@ -45,6 +45,8 @@
 
 #include <gpgme++/decryptionresult.h>
 
+#include <map>
+
 using namespace GpgME;
 using namespace Kleo;
 using namespace Kleo::Crypto;
@@ -61,6 +63,8 @@ public:
 
     QString getEmbeddedFileName(const QString &fileName) const;
     void exec();
+    void addPendingTasks();
+    void handleUndetected(const QStringList &undetected);
     std::vector<std::shared_ptr<Task> > buildTasks(const QStringList &, QStringList &);
 
     struct CryptoFile {
@@ -77,13 +81,30 @@ public:
         q->setLastError(err, details);
         q->emitDoneOrError();
     }
+    void reportFileError(const QString &fileName, int err, const QString &details)
+    {
+        Q_EMIT q->fileDone(fileName, err, details);
+        if (m_streaming) {
+            // reporting the error now would end a streaming operation
+            // while more files are still coming in
+            q->setLastError(err, details);
+        } else {
+            reportError(err, details);
+        }
+    }
     void cancelAllTasks();
 
-    QStringList m_passedFiles, m_filesAfterPreparation;
+    QStringList m_passedFiles, m_pendingFiles, m_filesAfterPreparation;
     std::vector<std::shared_ptr<const DecryptVerifyResult> > m_results;
     std::vector<std::shared_ptr<Task> > m_runnableTasks, m_completedTasks;
     std::shared_ptr<Task> m_runningTask;
+    std::map<const Task *, QString> m_taskFiles;
+    std::shared_ptr<TaskCollection> m_taskCollection;
     bool m_errorDetected = false;
+    bool m_streaming = false;
+    bool m_started = false;
+    bool m_endOfFiles = false;
+    bool m_finished = false;
     DecryptVerifyOperation m_operation = DecryptVerify;
     DecryptVerifyFilesDialog *m_dialog = nullptr;
     std::unique_ptr<QTemporaryDir> m_workDir;
@@ -107,7 +128,7 @@ void AutoDecryptVerifyFilesController::Private::schedule()
         t->start();
         m_runningTask = t;
     }
-    if (!m_runningTask) {
+    if (!m_runningTask && (!m_streaming || m_endOfFiles)) {
         kleo_assert(m_runnableTasks.empty());
         for (const std::shared_ptr<const DecryptVerifyResult> &i : std::as_const(m_results)) {
             Q_EMIT q->verificationResult(i->verificationResult());
@@ -133,36 +154,76 @@ QString AutoDecryptVerifyFilesController::Private::getEmbeddedFileName(const QSt
     }
 }
 
-void AutoDecryptVerifyFilesController::Private::exec()
+void AutoDecryptVerifyFilesController::Private::handleUndetected(const QStringList &undetected)
+{
+    if (undetected.isEmpty()) {
+        return;
+    }
+    // Since GpgME 1.7.0 Classification is supposed to be reliable
+    // so we really can't do anything with this data.
+    const QString details = xi18n("Failed to find encrypted or signed data in one or more files.<nl/>"
+                                  "You can manually select what to do with the files now.<nl/>"
+                                  "If they contain signed or encrypted data please report a bug (see Help->Report Bug).");
+    for (const QString &fileName : undetected) {
+        Q_EMIT q->fileDone(fileName, makeGnuPGError(GPG_ERR_NO_DATA), details);
+    }
+    if (m_streaming) {
+        q->setLastError(makeGnuPGError(GPG_ERR_GENERAL), details);
+    } else {
+        reportError(makeGnuPGError(GPG_ERR_GENERAL), details);
+    }
+    auto cmd = new Commands::DecryptVerifyFilesCommand(undetected, nullptr, true);
+    cmd->start();
+}
+
+void AutoDecryptVerifyFilesController::Private::addPendingTasks()
 {
-    Q_ASSERT(!m_dialog);
+    Q_ASSERT(m_taskCollection);
 
     QStringList undetected;
-    std::vector<std::shared_ptr<Task> > tasks = buildTasks(m_passedFiles, undetected);
-
-    if (!undetected.isEmpty()) {
-        // Since GpgME 1.7.0 Classification is supposed to be reliable
-        // so we really can't do anything with this data.
-        reportError(makeGnuPGError(GPG_ERR_GENERAL),
-                    xi18n("Failed to find encrypted or signed data in one or more files.<nl/>"
-                          "You can manually select what to do with the files now.<nl/>"
-                          "If they contain signed or encrypted data please report a bug (see Help->Report Bug)."));
-        auto cmd = new Commands::DecryptVerifyFilesCommand(undetected, nullptr, true);
-        cmd->start();
+    const std::vector<std::shared_ptr<Task> > tasks = buildTasks(m_pendingFiles, undetected);
+    m_pendingFiles.clear();
+    handleUndetected(undetected);
+
+    for (const std::shared_ptr<Task> &i : tasks) {
+        q->connectTask(i);
+    }
+    m_taskCollection->setTasks(tasks);
+    // tasks are taken from the back, so the new tasks go to the front
+    m_runnableTasks.insert(m_runnableTasks.begin(), tasks.cbegin(), tasks.cend());
+    QTimer::singleShot(0, q, SLOT(schedule()));
+}
+
+void AutoDecryptVerifyFilesController::Private::exec()
+{
+    if (m_dialog || m_finished) {
+        // in streaming mode, files that arrive later are added by addPendingTasks()
+        return;
     }
+
+    QStringList undetected;
+    std::vector<std::shared_ptr<Task> > tasks = buildTasks(m_pendingFiles, undetected);
+    m_pendingFiles.clear();
+    handleUndetected(undetected);
+
     if (tasks.empty()) {
+        if (m_streaming && !m_endOfFiles) {
+            // wait for more files
+            return;
+        }
+        m_finished = true;
         q->emitDoneOrError();
         return;
     }
     Q_ASSERT(m_runnableTasks.empty());
     m_runnableTasks.swap(tasks);
 
-    std::shared_ptr<TaskCollection> coll(new TaskCollection);
+    m_taskCollection = std::make_shared<TaskCollection>();
     for (const std::shared_ptr<Task> &i : std::as_const(m_runnableTasks)) {
         q->connectTask(i);
     }
-    coll->setTasks(m_runnableTasks);
-    m_dialog = new DecryptVerifyFilesDialog(coll);
+    m_taskCollection->setTasks(m_runnableTasks);
+    m_dialog = new DecryptVerifyFilesDialog(m_taskCollection);
     m_dialog->setOutputLocation(heuristicBaseDirectory(m_passedFiles));
 
     QTimer::singleShot(0, q, SLOT(schedule()));
@@ -257,6 +318,7 @@ void AutoDecryptVerifyFilesController::Private::exec()
             }
         }
     }
+    m_finished = true;
     q->emitDoneOrError();
     delete m_dialog;
     m_dialog = nullptr;
@@ -317,16 +379,16 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
         qCDebug(KLEOPATRA_LOG) << "classified" << cFile.fileName << "as" << printableClassification(cFile.classification);
 
         if (!fi.isReadable()) {
-            reportError(makeGnuPGError(GPG_ERR_ASS_NO_INPUT),
-                        xi18n("Cannot open <filename>%1</filename> for reading.", cFile.fileName));
+            reportFileError(cFile.fileName, makeGnuPGError(GPG_ERR_ASS_NO_INPUT),
+                            xi18n("Cannot open <filename>%1</filename> for reading.", cFile.fileName));
             continue;
         }
 
         if (mayBeAnyCertStoreType(cFile.classification)) {
             // Trying to verify a certificate. Possible because extensions are often similar
             // for PGP Keys.
-            reportError(makeGnuPGError(GPG_ERR_ASS_NO_INPUT),
-                        xi18n("The file <filename>%1</filename> contains certificates and can't be decrypted or verified.", cFile.fileName));
+            reportFileError(cFile.fileName, makeGnuPGError(GPG_ERR_ASS_NO_INPUT),
+                            xi18n("The file <filename>%1</filename> contains certificates and can't be decrypted or verified.", cFile.fileName));
             qCDebug(KLEOPATRA_LOG) << "reported error";
             continue;
         }
@@ -359,6 +421,7 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
                 t->setInput(Input::createFromFile(cFile.fileName));
                 t->setSignedData(input);
                 t->setProtocol(cFile.protocol);
+                m_taskFiles[t.get()] = cFile.fileName;
                 if (prepend) {
                     // Put the verify task BEFORE the decrypt task in the tasks queue,
                     // because the tasks are executed in reverse order!
@@ -387,6 +450,7 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
                 t->setInput(Input::createFromFile(cFile.fileName));
                 t->setSignedData(Input::createFromFile(signedDataFileName));
                 t->setProtocol(cFile.protocol);
+                m_taskFiles[t.get()] = cFile.fileName;
                 tasks.push_back(t);
             }
             continue;
@@ -411,6 +475,7 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
                     t->setInput(Input::createFromFile(sig));
                     t->setSignedData(Input::createFromFile(cFile.fileName));
                     t->setProtocol(proto);
+                    m_taskFiles[t.get()] = cFile.fileName;
                     tasks.push_back(t);
                 }
             }
@@ -458,6 +523,7 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
                 t->setInput(input);
                 t->setOutput(output);
                 t->setProtocol(cFile.protocol);
+                m_taskFiles[t.get()] = cFile.fileName;
                 tasks.push_back(t);
             } else {
                 // Any message. That is not an opaque signature needs to be
@@ -468,6 +534,7 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
                 t->setInput(input);
                 t->setOutput(output);
                 t->setProtocol(cFile.protocol);
+                m_taskFiles[t.get()] = cFile.fileName;
                 cFile.output = output;
                 tasks.push_back(t);
             }
@@ -480,6 +547,50 @@ std::vector< std::shared_ptr<Task> > AutoDecryptVerifyFilesController::Private::
 void AutoDecryptVerifyFilesController::setFiles(const QStringList &files)
 {
     d->m_passedFiles = files;
+    d->m_pendingFiles = files;
+}
+
+void AutoDecryptVerifyFilesController::setStreaming(bool streaming)
+{
+    d->m_streaming = streaming;
+}
+
+void AutoDecryptVerifyFilesController::addFiles(const QStringList &files)
+{
+    Q_ASSERT(d->m_streaming);
+    Q_ASSERT(!d->m_endOfFiles);
+    if (d->m_finished) {
+        for (const QString &fileName : files) {
+            Q_EMIT fileDone(fileName, makeGnuPGError(GPG_ERR_CANCELED), QString());
+        }
+        return;
+    }
+    if (d->m_dialog && d->m_passedFiles.isEmpty()) {
+        d->m_dialog->setOutputLocation(heuristicBaseDirectory(files));
+    }
+    d->m_passedFiles += files;
+    d->m_pendingFiles += files;
+    if (d->m_dialog) {
+        d->addPendingTasks();
+    } else if (d->m_started) {
+        // exec() runs the dialog in a nested event loop; don't block the caller
+        QTimer::singleShot(0, this, [this]() {
+            d->exec();
+        });
+    }
+}
+
+void AutoDecryptVerifyFilesController::endOfFiles()
+{
+    Q_ASSERT(d->m_streaming);
+    d->m_endOfFiles = true;
+    if (d->m_dialog) {
+        QTimer::singleShot(0, this, SLOT(schedule()));
+    } else if (d->m_started) {
+        QTimer::singleShot(0, this, [this]() {
+            d->exec();
+        });
+    }
 }
 
 AutoDecryptVerifyFilesController::AutoDecryptVerifyFilesController(QObject *parent) :
@@ -499,6 +610,7 @@ AutoDecryptVerifyFilesController::~AutoDecryptVerifyFilesController()
 
 void AutoDecryptVerifyFilesController::start()
 {
+    d->m_started = true;
     d->exec();
 }
 
@@ -542,7 +654,6 @@ void AutoDecryptVerifyFilesController::cancel()
 void AutoDecryptVerifyFilesController::doTaskDone(const Task *task, const std::shared_ptr<const Task::Result> &result)
 {
     Q_ASSERT(task);
-    Q_UNUSED(task)
 
     // We could just delete the tasks here, but we can't use
     // Qt::QueuedConnection here (we need sender()) and other slots
@@ -552,6 +663,12 @@ void AutoDecryptVerifyFilesController::doTaskDone(const Task *task, const std::s
     d->m_completedTasks.push_back(d->m_runningTask);
     d->m_runningTask.reset();
 
+    const auto it = d->m_taskFiles.find(task);
+    if (it != d->m_taskFiles.end()) {
+        Q_EMIT fileDone(it->second, result ? result->error().encodedError() : 0, result ? result->errorString() : QString());
+        d->m_taskFiles.erase(it);
+    }
+
     if (const std::shared_ptr<const DecryptVerifyResult> &dvr = std::dynamic_pointer_cast<const DecryptVerifyResult>(result)) {
         d->m_results.push_back(dvr);
     }
@@ -39,9 +39,26 @@ public:
     DecryptVerifyOperation operation() const override;
     void start() override;
 
+    /**
+     * Enables streaming of the input files. In streaming mode, start() may
+     * be called before all files are known. Additional files are passed
+     * with addFiles() while earlier files are already being processed, and
+     * the end of the list is signalled with endOfFiles().
+     */
+    void setStreaming(bool streaming);
+    void addFiles(const QStringList &files);
+    void endOfFiles();
+
 public Q_SLOTS:
     void cancel() override;
 
+Q_SIGNALS:
+    /**
+     * Emitted when the processing of @p fileName has finished. @p err is
+     * the (encoded) error code of the operation; 0 means success.
+     */
+    void fileDone(const QString &fileName, int err, const QString &details);
+
 private:
     void doTaskDone(const Task *task, const std::shared_ptr<const Task::Result> &) override;
 
@@ -0,0 +1,150 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    crypto/certificateresolutioncache.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "certificateresolutioncache.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/KeyCache>
+
+#include <KMime/HeaderParsing>
+
+#include <gpgme++/key.h>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace Kleo;
+using namespace Kleo::Crypto;
+using namespace KMime::Types;
+
+static const std::size_t MAX_ENTRIES = 32;
+
+namespace
+{
+QStringList sortedKeys(const std::vector<Mailbox> &mailboxes)
+{
+    QStringList result;
+    result.reserve(mailboxes.size());
+    std::transform(mailboxes.cbegin(), mailboxes.cend(), std::back_inserter(result), [](const Mailbox &mb) {
+        return mb.prettyAddress();
+    });
+    result.sort();
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+QString normalizedEMail(const Mailbox &mb)
+{
+    return mb.addrSpec().asString().toLower();
+}
+
+// creates one T per unique mailbox in the order of keys
+template<typename T>
+std::vector<T> resolveAll(const std::vector<Mailbox> &mailboxes, const QStringList &keys, std::set<QString> &emails)
+{
+    std::vector<T> result(keys.size());
+    for (const Mailbox &mb : mailboxes) {
+        const auto idx = std::lower_bound(keys.cbegin(), keys.cend(), mb.prettyAddress()) - keys.cbegin();
+        if (result[idx].isNull()) {
+            result[idx] = T(mb);
+            emails.insert(normalizedEMail(mb));
+        }
+    }
+    return result;
+}
+
+// returns the entries of resolved in the order of mailboxes
+template<typename T>
+std::vector<T> inOrder(const std::vector<Mailbox> &mailboxes, const QStringList &keys, const std::vector<T> &resolved)
+{
+    std::vector<T> result;
+    result.reserve(mailboxes.size());
+    for (const Mailbox &mb : mailboxes) {
+        const auto idx = std::lower_bound(keys.cbegin(), keys.cend(), mb.prettyAddress()) - keys.cbegin();
+        result.push_back(resolved[idx]);
+    }
+    return result;
+}
+}
+
+// static
+CertificateResolutionCache *CertificateResolutionCache::instance()
+{
+    static CertificateResolutionCache cache;
+    return &cache;
+}
+
+CertificateResolutionCache::CertificateResolutionCache()
+    : QObject()
+{
+    const auto keyCache = KeyCache::instance();
+    connect(keyCache.get(), &KeyCache::added, this, &CertificateResolutionCache::invalidate);
+    connect(keyCache.get(), &KeyCache::aboutToRemove, this, &CertificateResolutionCache::invalidate);
+    connect(keyCache.get(), &KeyCache::keyListingDone, this, &CertificateResolutionCache::clear);
+}
+
+void CertificateResolutionCache::resolve(const std::vector<Mailbox> &senders,
+                                         const std::vector<Mailbox> &recipients,
+                                         std::vector<Sender> &resolvedSenders,
+                                         std::vector<Recipient> &resolvedRecipients)
+{
+    const QStringList senderKeys = sortedKeys(senders);
+    const QStringList recipientKeys = sortedKeys(recipients);
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry &entry) {
+        return entry.senderKeys == senderKeys && entry.recipientKeys == recipientKeys;
+    });
+    if (it != m_entries.end()) {
+        ++m_hits;
+        m_entries.splice(m_entries.begin(), m_entries, it);
+    } else {
+        ++m_misses;
+        Entry entry;
+        entry.senderKeys = senderKeys;
+        entry.recipientKeys = recipientKeys;
+        entry.senders = resolveAll<Sender>(senders, senderKeys, entry.emails);
+        entry.recipients = resolveAll<Recipient>(recipients, recipientKeys, entry.emails);
+        m_entries.push_front(std::move(entry));
+        if (m_entries.size() > MAX_ENTRIES) {
+            m_entries.pop_back();
+        }
+    }
+    qCDebug(KLEOPATRA_LOG) << "CertificateResolutionCache:" << m_hits << "hits," << m_misses << "misses";
+
+    const Entry &entry = m_entries.front();
+    resolvedSenders = inOrder(senders, entry.senderKeys, entry.senders);
+    resolvedRecipients = inOrder(recipients, entry.recipientKeys, entry.recipients);
+}
+
+void CertificateResolutionCache::clear()
+{
+    m_entries.clear();
+}
+
+void CertificateResolutionCache::invalidate(const GpgME::Key &key)
+{
+    if (m_entries.empty()) {
+        return;
+    }
+    std::set<QString> emails;
+    for (const GpgME::UserID &uid : key.userIDs()) {
+        const std::string addrSpec = uid.addrSpec();
+        if (!addrSpec.empty()) {
+            emails.insert(QString::fromStdString(addrSpec).toLower());
+        }
+    }
+    m_entries.remove_if([&emails](const Entry &entry) {
+        return std::any_of(emails.cbegin(), emails.cend(), [&entry](const QString &email) {
+            return entry.emails.count(email) > 0;
+        });
+    });
+}
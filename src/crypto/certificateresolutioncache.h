@@ -0,0 +1,84 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    crypto/certificateresolutioncache.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include "recipient.h"
+#include "sender.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+
+#include <list>
+#include <set>
+#include <vector>
+
+namespace KMime
+{
+namespace Types
+{
+class Mailbox;
+}
+}
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+namespace Crypto
+{
+
+/**
+ * Remembers the certificate candidates of the senders and recipients of
+ * recently composed messages, so that a message to the same set of
+ * mailboxes does not need to look them up again.
+ *
+ * The order of the mailboxes does not matter. An entry is dropped when a
+ * certificate with an email address of one of its mailboxes is added to or
+ * removed from the key cache, and all entries are dropped when the key
+ * cache is refreshed.
+ *
+ * The class must only be used from the GUI thread.
+ */
+class CertificateResolutionCache : public QObject
+{
+    Q_OBJECT
+public:
+    static CertificateResolutionCache *instance();
+
+    void resolve(const std::vector<KMime::Types::Mailbox> &senders,
+                 const std::vector<KMime::Types::Mailbox> &recipients,
+                 std::vector<Sender> &resolvedSenders,
+                 std::vector<Recipient> &resolvedRecipients);
+
+    void clear();
+
+private:
+    CertificateResolutionCache();
+    void invalidate(const GpgME::Key &key);
+
+private:
+    struct Entry {
+        QStringList senderKeys;    // sorted
+        QStringList recipientKeys; // sorted
+        std::vector<Sender> senders;
+        std::vector<Recipient> recipients;
+        std::set<QString> emails;
+    };
+    std::list<Entry> m_entries; // most recently used first
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+}
+}
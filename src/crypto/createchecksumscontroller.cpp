@@ -15,6 +15,7 @@
 #include <utils/input.h>
 #include <utils/output.h>
 #include <utils/kleo_assert.h>
+#include <utils/path-helper.h>
 
 #include <Libkleo/Stl_Util>
 #include <Libkleo/ChecksumDefinition>
@@ -478,7 +479,8 @@ static std::vector<Dir> find_dirs_by_input_files(const QStringList &files, const
 static QString process(const Dir &dir, bool *fatal)
 {
     const QString absFilePath = dir.dir.absoluteFilePath(dir.sumFile);
-    QTemporaryFile out;
+    // create the temporary file next to the checksum file, so that it can be renamed
+    QTemporaryFile out(absFilePath);
     QProcess p;
     if (!out.open()) {
         return QStringLiteral("Failed to open Temporary file.");
@@ -502,8 +504,10 @@ static QString process(const Dir &dir, bool *fatal)
         }
     }
 
-    QFileInfo fi(absFilePath);
-    if (!(fi.exists() && !QFile::remove(absFilePath)) && QFile::copy(out.fileName(), absFilePath)) {
+    const QString tmpFileName = out.fileName();
+    out.close();
+    if (replaceFile(tmpFileName, absFilePath)) {
+        out.setAutoRemove(false);
         return QString();
     }
 
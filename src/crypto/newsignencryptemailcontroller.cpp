@@ -14,6 +14,7 @@
 #include "encryptemailtask.h"
 #include "signemailtask.h"
 #include "taskcollection.h"
+#include "certificateresolutioncache.h"
 #include "sender.h"
 #include "recipient.h"
 
@@ -202,26 +203,6 @@ static bool is_de_vs_compliant(bool sign, bool encrypt, const std::vector<Sender
 // END Conflict Detection
 //
 
-static std::vector<Sender> mailbox2sender(const std::vector<Mailbox> &mbs)
-{
-    std::vector<Sender> senders;
-    senders.reserve(mbs.size());
-    for (const Mailbox &mb : mbs) {
-        senders.push_back(Sender(mb));
-    }
-    return senders;
-}
-
-static std::vector<Recipient> mailbox2recipient(const std::vector<Mailbox> &mbs)
-{
-    std::vector<Recipient> recipients;
-    recipients.reserve(mbs.size());
-    for (const Mailbox &mb : mbs) {
-        recipients.push_back(Recipient(mb));
-    }
-    return recipients;
-}
-
 class NewSignEncryptEMailController::Private
 {
     friend class ::Kleo::Crypto::NewSignEncryptEMailController;
@@ -251,6 +232,10 @@ private:
     bool detached : 1;
     Protocol presetProtocol;
     std::vector<Key> signers, recipients;
+    // for estimating the memory used by the dialog
+    qint64 mailboxCount = 0;
+    qint64 mailboxTextSize = 0;
+    qint64 candidateCount = 0;
     std::vector< std::shared_ptr<Task> > runnable, completed;
     std::shared_ptr<Task> cms, openpgp;
     QPointer<SignEncryptEMailConflictDialog> dialog;
@@ -382,8 +367,9 @@ void NewSignEncryptEMailController::startResolveCertificates(const std::vector<M
     d->certificatesResolved = false;
     d->resolvingInProgress = true;
 
-    const std::vector<Sender> senders = mailbox2sender(s);
-    const std::vector<Recipient> recipients = mailbox2recipient(r);
+    std::vector<Sender> senders;
+    std::vector<Recipient> recipients;
+    CertificateResolutionCache::instance()->resolve(s, r, senders, recipients);
     const bool quickMode = is_dialog_quick_mode(d->sign, d->encrypt);
 
     const bool conflict = quickMode && has_conflict(d->sign, d->encrypt, senders, recipients, d->presetProtocol);
@@ -391,6 +377,22 @@ void NewSignEncryptEMailController::startResolveCertificates(const std::vector<M
     d->dialog->setQuickMode(quickMode);
     d->dialog->setSenders(senders);
     d->dialog->setRecipients(recipients);
+
+    d->mailboxCount = senders.size() + recipients.size();
+    d->mailboxTextSize = 0;
+    d->candidateCount = 0;
+    for (const Sender &sender : senders) {
+        d->mailboxTextSize += sender.mailbox().prettyAddress().size() * sizeof(QChar);
+        for (const Protocol proto : {OpenPGP, CMS}) {
+            d->candidateCount += sender.signingCertificateCandidates(proto).size() + sender.encryptToSelfCertificateCandidates(proto).size();
+        }
+    }
+    for (const Recipient &recipient : recipients) {
+        d->mailboxTextSize += recipient.mailbox().prettyAddress().size() * sizeof(QChar);
+        for (const Protocol proto : {OpenPGP, CMS}) {
+            d->candidateCount += recipient.encryptionCertificateCandidates(proto).size();
+        }
+    }
     d->dialog->pickProtocol();
     d->dialog->setConflict(conflict);
 
@@ -408,6 +410,18 @@ void NewSignEncryptEMailController::startResolveCertificates(const std::vector<M
     }
 }
 
+qint64 NewSignEncryptEMailController::estimatedSize() const
+{
+    // guesses for the controller with its dialog, for the widgets the dialog
+    // shows per mailbox, and per certificate; the data of the certificates
+    // is mostly shared with the key cache
+    static const qint64 baseSize = 16 * 1024;
+    static const qint64 mailboxSize = 2 * 1024;
+    static const qint64 certificateSize = 256;
+    const qint64 certificates = d->candidateCount + d->signers.size() + d->recipients.size();
+    return baseSize + d->mailboxCount * mailboxSize + d->mailboxTextSize + certificates * certificateSize;
+}
+
 void NewSignEncryptEMailController::Private::slotDialogAccepted()
 {
     if (dialog->isQuickMode() != is_dialog_quick_mode(sign, encrypt)) {
@@ -81,6 +81,13 @@ public:
     void startEncryption(const std::vector< std::shared_ptr<Kleo::Input> > &inputs,
                          const std::vector< std::shared_ptr<Kleo::Output> > &outputs);
 
+    /**
+     * Returns a rough estimate of the memory used by the controller in
+     * bytes, including its dialog and the mailboxes and certificates it
+     * holds.
+     */
+    qint64 estimatedSize() const;
+
 public Q_SLOTS:
     void cancel();
 
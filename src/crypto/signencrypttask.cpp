@@ -458,6 +458,9 @@ void SignEncryptTask::doStart()
     if (!d->output) {
         d->output = Output::createFromFile(d->outputFileName, d->m_overwritePolicy);
     }
+    if (!d->detached) {
+        d->output->reserve(inputSize());
+    }
 
     if (d->encrypt || d->symmetric) {
         Context::EncryptionFlags flags = Context::AlwaysTrust;
@@ -212,6 +212,10 @@ std::vector<std::shared_ptr<Task> > TaskCollection::tasks() const
 
 void TaskCollection::setTasks(const std::vector<std::shared_ptr<Task> > &tasks)
 {
+    if (!tasks.empty()) {
+        // tasks may be added to a collection that has already signalled done
+        d->m_doneEmitted = false;
+    }
     for (const std::shared_ptr<Task> &i : tasks) {
         Q_ASSERT(i);
         d->m_tasks[i->id()] = i;
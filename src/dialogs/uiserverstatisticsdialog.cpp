@@ -0,0 +1,121 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    dialogs/uiserverstatisticsdialog.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "uiserverstatisticsdialog.h"
+
+#include <uiserver/serverstatistics.h>
+#include <uiserver/sessiondata.h>
+
+#include <KConfigGroup>
+#include <KLocalizedString>
+#include <KSharedConfig>
+
+#include <QDialogButtonBox>
+#include <QFontDatabase>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QTimer>
+#include <QVBoxLayout>
+
+using namespace Kleo;
+using namespace Kleo::Dialogs;
+
+static const int UPDATE_INTERVAL = 1000; // milliseconds
+
+class UiServerStatisticsDialog::Private
+{
+    friend class ::Kleo::Dialogs::UiServerStatisticsDialog;
+    UiServerStatisticsDialog *const q;
+
+public:
+    explicit Private(UiServerStatisticsDialog *qq);
+
+private:
+    void update()
+    {
+        const int scrollPosition = ui.textEdit->verticalScrollBar()->value();
+        const QByteArray stats = ServerStatistics::instance()->dump() + SessionDataHandler::instance()->dumpStatistics();
+        ui.textEdit->setPlainText(QString::fromLatin1(stats));
+        ui.textEdit->verticalScrollBar()->setValue(scrollPosition);
+    }
+
+    void readConfig()
+    {
+        KConfigGroup dialog(KSharedConfig::openStateConfig(), "UiServerStatisticsDialog");
+        const QSize size = dialog.readEntry("Size", QSize(800, 500));
+        if (size.isValid()) {
+            q->resize(size);
+        }
+    }
+
+    void writeConfig()
+    {
+        KConfigGroup dialog(KSharedConfig::openStateConfig(), "UiServerStatisticsDialog");
+        dialog.writeEntry("Size", q->size());
+        dialog.sync();
+    }
+
+private:
+    QTimer updateTimer;
+
+    struct UI {
+        QPlainTextEdit *textEdit = nullptr;
+        QDialogButtonBox *buttonBox = nullptr;
+    } ui;
+};
+
+UiServerStatisticsDialog::Private::Private(UiServerStatisticsDialog *qq)
+    : q(qq)
+{
+    q->setWindowTitle(i18nc("@title:window", "UI Server Statistics"));
+
+    auto vlay = new QVBoxLayout(q);
+
+    ui.textEdit = new QPlainTextEdit(q);
+    ui.textEdit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    ui.textEdit->setReadOnly(true);
+    ui.textEdit->setLineWrapMode(QPlainTextEdit::NoWrap);
+    vlay->addWidget(ui.textEdit, 1);
+
+    ui.buttonBox = new QDialogButtonBox(QDialogButtonBox::Close, q);
+    vlay->addWidget(ui.buttonBox);
+    QObject::connect(ui.buttonBox, &QDialogButtonBox::rejected, q, &QDialog::reject);
+
+    updateTimer.setInterval(UPDATE_INTERVAL);
+    QObject::connect(&updateTimer, &QTimer::timeout, q, [this]() {
+        update();
+    });
+
+    readConfig();
+}
+
+UiServerStatisticsDialog::UiServerStatisticsDialog(QWidget *parent)
+    : QDialog(parent), d(new Private(this))
+{
+}
+
+UiServerStatisticsDialog::~UiServerStatisticsDialog()
+{
+    d->writeConfig();
+}
+
+void UiServerStatisticsDialog::showEvent(QShowEvent *event)
+{
+    d->update();
+    d->updateTimer.start();
+    QDialog::showEvent(event);
+}
+
+void UiServerStatisticsDialog::hideEvent(QHideEvent *event)
+{
+    d->updateTimer.stop();
+    QDialog::hideEvent(event);
+}
@@ -0,0 +1,43 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    dialogs/uiserverstatisticsdialog.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QDialog>
+
+#include <utils/pimpl_ptr.h>
+
+namespace Kleo
+{
+namespace Dialogs
+{
+
+/**
+ * Shows the performance statistics of the UI server, i.e. the same
+ * information that is reported by GETINFO stats. The view is updated
+ * periodically while the dialog is visible.
+ */
+class UiServerStatisticsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit UiServerStatisticsDialog(QWidget *parent = nullptr);
+    ~UiServerStatisticsDialog() override;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    class Private;
+    kdtools::pimpl_ptr<Private> d;
+};
+
+}
+}
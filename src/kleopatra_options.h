@@ -21,6 +21,8 @@ static void kleopatra_options(QCommandLineParser *parser)
         QCommandLineOption({QStringLiteral("cms"), QStringLiteral("c")}, i18n("Use CMS (X.509, S/MIME) for the following operation")),
         QCommandLineOption(QStringLiteral("uiserver-socket"), i18n("Location of the socket the ui server is listening on"), QStringLiteral("argument")),
         QCommandLineOption(QStringLiteral("daemon"), i18n("Run UI server only, hide main window")),
+        QCommandLineOption(QStringLiteral("notify-uiserver-ready"), i18n("Connect to the given local socket once the UI server accepts connections"), QStringLiteral("name")),
+        QCommandLineOption(QStringLiteral("headless"), i18n("Run UI server only, without system tray icon and smart card monitoring (implies --daemon)")),
         QCommandLineOption({QStringLiteral("import-certificate"), QStringLiteral("i")}, i18n("Import certificate file(s)")),
         QCommandLineOption({QStringLiteral("encrypt"), QStringLiteral("e")}, i18n("Encrypt file(s)")),
         QCommandLineOption({QStringLiteral("sign"), QStringLiteral("s")}, i18n("Sign file(s)")),
@@ -24,6 +24,7 @@
 #include <conf/configuredialog.h>
 
 #include <Libkleo/GnuPG>
+#include <utils/keycachereconciler.h>
 #include <utils/kdpipeiodevice.h>
 #include <utils/log.h>
 
@@ -157,6 +158,7 @@ public:
         : q(qq)
         , ignoreNewInstance(true)
         , firstNewInstance(true)
+        , headless(false)
         , sysTray(nullptr)
         , groupConfig{std::make_shared<KeyGroupConfig>(QStringLiteral("kleopatragroupsrc"))}
     {
@@ -208,6 +210,7 @@ private:
 public:
     bool ignoreNewInstance;
     bool firstNewInstance;
+    bool headless;
     QPointer<FocusFrame> focusFrame;
     QPointer<ConfigureDialog> configureDialog;
     QPointer<MainWindow> mainWindow;
@@ -219,18 +222,24 @@ public:
     std::shared_ptr<KeyCache> keyCache;
     std::shared_ptr<Log> log;
     std::shared_ptr<FileSystemWatcher> watcher;
+    KeyCacheReconciler *keyCacheReconciler = nullptr;
 
 public:
     void setupKeyCache()
     {
         keyCache = KeyCache::mutableInstance();
-        keyCache->setRefreshInterval(SMimeValidationPreferences{}.refreshInterval());
         watcher.reset(new FileSystemWatcher);
 
         watcher->whitelistFiles(gnupgFileWhitelist());
         watcher->addPaths(gnupgFolderWhitelist());
         watcher->setDelay(1000);
-        keyCache->addFileSystemWatcher(watcher);
+        // update only the keys that have changed instead of letting the key
+        // cache reload all keys on every change of the keyrings
+        keyCacheReconciler = new KeyCacheReconciler(watcher, q);
+        // the reconciler reloads the key cache periodically, because it
+        // has to disable the watcher during the reloading
+        keyCache->setRefreshInterval(0);
+        keyCacheReconciler->setRefreshInterval(SMimeValidationPreferences{}.refreshInterval());
         keyCache->setGroupConfig(groupConfig);
         keyCache->setGroupsEnabled(Settings().groupsEnabled());
     }
@@ -266,6 +275,16 @@ public:
         if (logAll || options.contains("io")) {
             log->setIOLoggingEnabled(true);
         }
+        for (const QByteArray &option : options) {
+            // e.g. io-limit=64 to log only the first 64 KiB of each stream,
+            // or io-sample=10 to log only every 10th stream
+            const QByteArray value = option.mid(option.indexOf('=') + 1);
+            if (option.startsWith("io-limit=")) {
+                log->setIOLoggingLimit(value.toLongLong() * 1024);
+            } else if (option.startsWith("io-sample=")) {
+                log->setIOLoggingSampleRate(value.toUInt());
+            }
+        }
         qInstallMessageHandler(Log::messageHandler);
 
         if (logAll || options.contains("pipeio")) {
@@ -300,8 +319,9 @@ KleopatraApplication::KleopatraApplication(int &argc, char *argv[])
             });
 }
 
-void KleopatraApplication::init()
+void KleopatraApplication::init(bool headless)
 {
+    d->headless = headless;
 #ifdef Q_OS_WIN
     QWindowsWindowFunctions::setWindowActivationBehavior(
             QWindowsWindowFunctions::AlwaysActivateWindow);
@@ -322,7 +342,6 @@ void KleopatraApplication::init()
     connect(&d->readerStatus, &SmartCard::ReaderStatus::startOfGpgAgentRequested,
             this, &KleopatraApplication::startGpgAgent);
     d->setupKeyCache();
-    d->setUpSysTrayIcon();
     d->setUpFilterManager();
     d->setupLogging();
 #ifdef Q_OS_WIN
@@ -332,9 +351,12 @@ void KleopatraApplication::init()
         QIcon::setThemeName("breeze-dark");
     }
 #endif
+    if (!headless) {
+        d->setUpSysTrayIcon();
 #ifndef QT_NO_SYSTEMTRAYICON
-    d->sysTray->show();
+        d->sysTray->show();
 #endif
+    }
     setQuitOnLastWindowClosed(false);
     KWindowSystem::allowExternalProcessWindowActivation();
 }
@@ -607,7 +629,18 @@ void KleopatraApplication::setMainWindow(MainWindow *mainWindow)
 
     d->mainWindow = mainWindow;
 #ifndef QT_NO_SYSTEMTRAYICON
-    d->sysTray->setMainWindow(mainWindow);
+    if (!d->sysTray && mainWindow) {
+        // in headless mode the tray icon and the smart card monitoring are
+        // only needed once the user has asked for the main window
+        d->setUpSysTrayIcon();
+        d->sysTray->show();
+        if (d->headless) {
+            d->readerStatus.startMonitoring();
+        }
+    }
+    if (d->sysTray) {
+        d->sysTray->setMainWindow(mainWindow);
+    }
 #endif
 
     d->connectConfigureDialog();
@@ -719,6 +752,10 @@ void KleopatraApplication::openOrRaiseConfigDialog()
 #ifndef QT_NO_SYSTEMTRAYICON
 void KleopatraApplication::startMonitoringSmartCard()
 {
+    if (d->headless) {
+        // started by setMainWindow()
+        return;
+    }
     d->readerStatus.startMonitoring();
 }
 #endif // QT_NO_SYSTEMTRAYICON
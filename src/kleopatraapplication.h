@@ -36,8 +36,12 @@ public:
 
     /** Initialize the application. Without calling init any
      * other call to KleopatraApplication will result in undefined behavior
-     * and likely crash. */
-    void init();
+     * and likely crash.
+     *
+     * If @p headless is true, only the parts needed by the UI server are
+     * set up. The system tray icon is created when the main window is
+     * opened for the first time, and smart card monitoring is not started. */
+    void init(bool headless = false);
 
     static KleopatraApplication *instance()
     {
@@ -26,10 +26,20 @@
 #endif
 
 #include <QMutexLocker>
+#include <QCoreApplication>
 #include <QFile>
 #include "libkleopatraclientcore_debug.h"
 #include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLocalServer>
+#include <QPointer>
 #include <QProcess>
+#include <QRandomGenerator>
+#include <QThreadPool>
+#include <QTimer>
 #include <KLocalizedString>
 
 #include <assuan.h>
@@ -37,6 +47,9 @@
 #include <gpgme++/global.h>
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <string>
 #include <sstream>
 #include <memory>
@@ -103,24 +116,98 @@ static std::string hexencode(const QByteArray &in)
 Command::Command(QObject *p)
     : QObject(p), d(new Private(this))
 {
-    d->init();
 }
 
 Command::Command(Private *pp, QObject *p)
     : QObject(p), d(pp)
 {
-    d->init();
 }
 
 Command::~Command()
 {
+    d->wait();
     delete d; d = nullptr;
 }
 
-void Command::Private::init()
+// Commands are run by a shared thread pool instead of a thread per
+// command, so that clients firing many commands don't pay for creating
+// a thread each time. The number of threads is not limited, because
+// commands like SELECT_CERTIFICATE block until the user is done, and a
+// command waiting for a free thread would deadlock a client that waits
+// for it while another command blocks.
+static QThreadPool *command_thread_pool()
 {
-    connect(this, &QThread::started,  q, &Command::started);
-    connect(this, &QThread::finished, q, &Command::finished);
+    static QThreadPool *pool = [] {
+        auto p = new QThreadPool;
+        p->setMaxThreadCount(std::numeric_limits<int>::max());
+        return p;
+    }();
+    return pool;
+}
+
+void Command::Private::start()
+{
+    {
+        const QMutexLocker locker(&runningMutex);
+        if (running) {
+            return;
+        }
+        running = true;
+    }
+    command_thread_pool()->start(this);
+}
+
+// static
+void Command::Private::startBatch(const std::vector<Command *> &commands)
+{
+    std::vector<Private *> batch;
+    for (Command *command : commands) {
+        Private *const d = command->d;
+        const QMutexLocker locker(&d->runningMutex);
+        if (!d->running) {
+            d->running = true;
+            batch.push_back(d);
+        }
+    }
+    if (batch.empty()) {
+        return;
+    }
+    // each command takes the connection the previous one has put back
+    // into the pool
+    command_thread_pool()->start([batch]() {
+        for (Private *d : batch) {
+            d->run();
+        }
+    });
+}
+
+bool Command::Private::wait(unsigned long ms)
+{
+    const QMutexLocker locker(&runningMutex);
+    while (running) {
+        if (!finishedCondition.wait(&runningMutex, ms)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Command::submit(const QObject *context, const std::function<void(Command *)> &callback)
+{
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = connect(this, &Command::finished, context, [that = QPointer<Command>(this), callback, connection]() {
+        QObject::disconnect(*connection);
+        if (that) {
+            callback(that);
+        }
+    });
+    start();
+}
+
+// static
+void Command::startBatch(const std::vector<Command *> &commands)
+{
+    Private::startBatch(commands);
 }
 
 void Command::setParentWId(WId wid)
@@ -443,16 +530,151 @@ static QString uiserver_executable()
     return QStringLiteral("kleopatra");
 }
 
-static QString start_uiserver()
+static QString start_uiserver(const QString &readyServerName)
 {
+    QStringList arguments{QStringLiteral("--daemon")};
+    if (!readyServerName.isEmpty()) {
+        arguments << QStringLiteral("--notify-uiserver-ready") << readyServerName;
+    }
     // Warning: Don't assume that the program needs to be in PATH. On Windows, it will also be found next to the calling process.
-    if (!QProcess::startDetached(uiserver_executable(), QStringList() << QStringLiteral("--daemon"))) {
+    if (!QProcess::startDetached(uiserver_executable(), arguments)) {
         return i18n("Failed to start uiserver %1", uiserver_executable());
     } else {
         return QString();
     }
 }
 
+// Waits until the UI server started by start_uiserver() accepts
+// connections. The UI server connects to readyServer as soon as it
+// listens on its socket. If an already running Kleopatra was asked to
+// start the UI server, the notification may not come, so the connection
+// is also retried whenever the socket's directory changes.
+static gpg_error_t wait_for_uiserver(const AssuanClientContext &ctx, const QString &socketName, QLocalServer &readyServer)
+{
+    static const int TIMEOUT = 10000; // ms
+
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
+    QObject::connect(&readyServer, &QLocalServer::newConnection, &loop, &QEventLoop::quit);
+    QFileSystemWatcher watcher(QStringList{QFileInfo(socketName).absolutePath()});
+    QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged, &loop, &QEventLoop::quit);
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    timer.start(TIMEOUT);
+    gpg_error_t err = 0;
+    while ((err = assuan_socket_connect(ctx.get(), socketName.toUtf8().constData(), -1, 0)) && timer.isActive()) {
+        loop.exec();
+    }
+    qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "UI server" << (err ? "not ready" : "ready") << "after" << elapsed.elapsed() << "ms";
+    return err;
+}
+
+namespace
+{
+// Connections to the UI server are kept open after a command is done and
+// reused by the next command, so that clients firing many commands don't
+// pay for connecting each time. Idle connections are closed after a short
+// while, because each of them occupies a thread of the UI server and counts
+// towards its connection limit.
+class ConnectionPool
+{
+public:
+    struct Connection {
+        AssuanClientContext ctx;
+        qint64 serverPid = 0;
+        QElapsedTimer idleTimer;
+    };
+
+    static ConnectionPool &instance()
+    {
+        static ConnectionPool pool;
+        return pool;
+    }
+
+    // returns a working idle connection to socketName, or a null one
+    Connection take(const QString &socketName)
+    {
+        closeExpired();
+        while (true) {
+            Connection conn;
+            {
+                const QMutexLocker locker(&mutex);
+                auto &conns = idle[socketName];
+                if (conns.empty()) {
+                    return Connection();
+                }
+                conn = conns.back();
+                conns.pop_back();
+            }
+            // the server might have gone away in the meantime
+            if (!assuan_transact(conn.ctx.get(), "NOP", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr)) {
+                return conn;
+            }
+            qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Dropping stale connection to" << socketName;
+        }
+    }
+
+    // resets conn and keeps it for reuse, unless there are enough idle connections
+    void put(const QString &socketName, Connection conn)
+    {
+        if (assuan_transact(conn.ctx.get(), "RESET", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr)) {
+            return;
+        }
+        conn.idleTimer.start();
+        {
+            const QMutexLocker locker(&mutex);
+            auto &conns = idle[socketName];
+            if (conns.size() >= MAX_IDLE_CONNECTIONS) {
+                return;
+            }
+            conns.push_back(conn);
+        }
+        // commands run in worker threads without an event loop, so the
+        // timer is started in the application's main thread
+        if (QCoreApplication::instance()) {
+            QMetaObject::invokeMethod(QCoreApplication::instance(), []() {
+                QTimer::singleShot(IDLE_TIMEOUT, []() {
+                    ConnectionPool::instance().closeExpired();
+                });
+            }, Qt::QueuedConnection);
+        }
+    }
+
+private:
+    void closeExpired()
+    {
+        std::vector<Connection> expired;
+        {
+            const QMutexLocker locker(&mutex);
+            for (auto &entry : idle) {
+                auto &conns = entry.second;
+                const auto it = std::stable_partition(conns.begin(), conns.end(), [](const Connection &conn) {
+                    // coarse timers may fire up to 5 % early
+                    return !conn.idleTimer.hasExpired(IDLE_TIMEOUT - IDLE_TIMEOUT / 20);
+                });
+                std::move(it, conns.end(), std::back_inserter(expired));
+                conns.erase(it, conns.end());
+            }
+        }
+        if (!expired.empty()) {
+            qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Closing" << expired.size() << "idle connections";
+        }
+        // the connections are closed when expired goes out of scope,
+        // i.e. outside of the lock
+    }
+
+private:
+    static const std::size_t MAX_IDLE_CONNECTIONS = 4;
+    static const int IDLE_TIMEOUT = 2000; // ms
+
+    QMutex mutex;
+    std::map<QString, std::vector<Connection>> idle;
+};
+}
+
 static gpg_error_t getinfo_pid_cb(void *opaque, const void *buffer, size_t length)
 {
     qint64 &pid = *static_cast<qint64 *>(opaque);
@@ -542,9 +764,12 @@ void Command::Private::run()
     {
         const QMutexLocker locker(&mutex);
         in = inputs;
+        out.serverLocation = outputs.serverLocation;
         outputs = out;
     }
 
+    Q_EMIT q->started();
+
     out.canceled = false;
 
     if (out.serverLocation.isEmpty()) {
@@ -553,6 +778,7 @@ void Command::Private::run()
 
     AssuanClientContext ctx;
     gpg_error_t err = 0;
+    bool reusable = false;
 
     inquire_data id = { &in.inquireData, &ctx };
 
@@ -562,6 +788,12 @@ void Command::Private::run()
         goto leave;
     }
 
+    if (const ConnectionPool::Connection conn = ConnectionPool::instance().take(socketName); conn.ctx) {
+        ctx = conn.ctx;
+        out.serverPid = conn.serverPid;
+        goto connected;
+    }
+
     {
         assuan_context_t naked_ctx = nullptr;
         err = assuan_new(&naked_ctx);
@@ -578,17 +810,19 @@ void Command::Private::run()
     if (err) {
         qDebug("UI server not running, starting it");
 
-        const QString errorString = start_uiserver();
+        QLocalServer readyServer;
+        readyServer.setSocketOptions(QLocalServer::UserAccessOption);
+        if (!readyServer.listen(QStringLiteral("kleopatraclient-%1-%2").arg(QCoreApplication::applicationPid()).arg(QRandomGenerator::global()->generate()))) {
+            qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Cannot listen for the readiness of the UI server:" << readyServer.errorString();
+        }
+
+        const QString errorString = start_uiserver(readyServer.fullServerName());
         if (!errorString.isEmpty()) {
             out.errorString = errorString;
             goto leave;
         }
 
-        // give it a bit of time to start up and try a couple of times
-        for (int i = 0; err && i < 20; ++i) {
-            msleep(500);
-            err = assuan_socket_connect(ctx.get(), socketName.toUtf8().constData(), -1, 0);
-        }
+        err = wait_for_uiserver(ctx, socketName, readyServer);
     }
 
     if (err) {
@@ -606,6 +840,8 @@ void Command::Private::run()
 
     qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "Server PID =" << out.serverPid;
 
+connected:
+    reusable = true;
 #if defined(Q_OS_WIN)
     if (!AllowSetForegroundWindow((pid_t)out.serverPid)) {
         qCDebug(LIBKLEOPATRACLIENTCORE_LOG) << "AllowSetForegroundWindow(" << out.serverPid << ") failed: " << GetLastError();
@@ -669,7 +905,18 @@ void Command::Private::run()
     }
 
 leave:
-    const QMutexLocker locker(&mutex);
-    // copy outputs to where Command can see them:
-    outputs = out;
+    if (reusable) {
+        ConnectionPool::instance().put(socketName, {ctx, out.serverPid});
+    }
+    {
+        const QMutexLocker locker(&mutex);
+        // copy outputs to where Command can see them:
+        outputs = out;
+    }
+
+    Q_EMIT q->finished();
+
+    const QMutexLocker locker(&runningMutex);
+    running = false;
+    finishedCondition.wakeAll();
 }
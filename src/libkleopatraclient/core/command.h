@@ -14,6 +14,9 @@
 #include <QObject>
 #include <QWidget> // only for WId, doesn't prevent linking against QtCore-only
 
+#include <functional>
+#include <vector>
+
 class QString;
 class QByteArray;
 class QVariant;
@@ -43,6 +46,20 @@ public:
 
     qint64 serverPid() const;
 
+    /**
+     * Starts the command and calls @p callback with this command in the
+     * thread of @p context when the command has finished. The callback
+     * is not called if either of them has been destroyed by then.
+     */
+    void submit(const QObject *context, const std::function<void(Command *)> &callback);
+
+    /**
+     * Starts all of @p commands that are not running. They are run one
+     * after the other in one worker thread and over one connection to the
+     * UI server. Each command emits started() and finished() as usual.
+     */
+    static void startBatch(const std::vector<Command *> &commands);
+
 public Q_SLOTS:
     void start();
     void cancel();
@@ -10,37 +10,43 @@
 
 #include "command.h"
 
-#include <QThread>
+#include <QMutex>
 #include <QRecursiveMutex>
+#include <QRunnable>
+#include <QWaitCondition>
 
 #include <QString>
 #include <QStringList>
 #include <QByteArray>
 #include <QVariant>
 
+#include <climits>
 #include <map>
 #include <string>
+#include <vector>
 
-class KleopatraClientCopy::Command::Private : public QThread
+class KleopatraClientCopy::Command::Private : public QRunnable
 {
-    Q_OBJECT
 private:
     friend class ::KleopatraClientCopy::Command;
     Command *const q;
 public:
     explicit Private(Command *qq)
-        : QThread(),
+        : QRunnable(),
           q(qq),
           mutex(),
           inputs(),
-          outputs()
+          outputs(),
+          running(false)
     {
-
+        setAutoDelete(false);
     }
     ~Private() override {}
 
 private:
-    void init();
+    void start();
+    static void startBatch(const std::vector<Command *> &commands);
+    bool wait(unsigned long ms = ULONG_MAX);
 
 private:
     void run() override;
@@ -71,5 +77,9 @@ private:
         qint64 serverPid;
         QString serverLocation;
     } outputs;
-};
 
+    // guards running; QWaitCondition cannot be used with a recursive mutex
+    QMutex runningMutex;
+    QWaitCondition finishedCondition;
+    bool running;
+};
@@ -27,6 +27,7 @@
 
 #include <Libkleo/GnuPG>
 #include <utils/archivedefinition.h>
+#include "utils/keycachesnapshot.h"
 #include "utils/kuniqueservice.h"
 #include "utils/userinfo.h"
 
@@ -63,6 +64,7 @@
 #include <QTimer>
 #include <QTime>
 #include <QEventLoop>
+#include <QLocalSocket>
 #include <QThreadPool>
 #include <QElapsedTimer>
 
@@ -89,10 +91,28 @@ static bool selfCheck()
     }
 }
 
+// tells a libkleopatraclient client that started us that the UI server
+// accepts connections
+static void notifyUiServerReady(const QString &name)
+{
+    QLocalSocket socket;
+    socket.connectToServer(name, QIODevice::WriteOnly);
+    if (!socket.waitForConnected(1000)) {
+        qCDebug(KLEOPATRA_LOG) << "Failed to notify" << name << "about the UI server:" << socket.errorString();
+        return;
+    }
+    socket.disconnectFromServer();
+}
+
 static void fillKeyCache(Kleo::UiServer *server)
 {
+    // Don't make clients wait for the complete key listing. Until the key
+    // cache is initialized the server looks up the keys of the senders and
+    // recipients of each command with a targeted key listing.
+    server->enableCryptoCommands();
+    // Show the certificates of the last session right away
+    Kleo::KeyCacheSnapshot::instance()->restore();
     auto cmd = new Kleo::ReloadKeysCommand(nullptr);
-    QObject::connect(cmd, SIGNAL(finished()), server, SLOT(enableCryptoCommands()));
     cmd->start();
 }
 
@@ -163,8 +183,6 @@ int main(int argc, char **argv)
     // have terminated us and so we can avoid overhead (e.g. keycache
     // setup / systray icon).
     qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Service created";
-    app.init();
-    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Application initialized";
 
     QCommandLineParser parser;
     aboutData.setupCommandLine(&parser);
@@ -172,6 +190,10 @@ int main(int argc, char **argv)
 
     parser.process(QApplication::arguments());
     aboutData.processCommandLine(&parser);
+
+    const bool headless = parser.isSet(QStringLiteral("headless"));
+    app.init(headless);
+    qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: Application initialized";
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
     Kdelibs4ConfigMigrator migrate(QStringLiteral("kleopatra"));
     migrate.setConfigFiles(QStringList() << QStringLiteral("kleopatrarc")
@@ -222,6 +244,9 @@ int main(int argc, char **argv)
 
         server->start();
         qCDebug(KLEOPATRA_LOG) << "Startup timing:" << timer.elapsed() << "ms elapsed: UiServer started";
+        if (parser.isSet(QStringLiteral("notify-uiserver-ready"))) {
+            notifyUiServerReady(parser.value(QStringLiteral("notify-uiserver-ready")));
+        }
     } catch (const std::exception &e) {
         qCDebug(KLEOPATRA_LOG) << "Failed to start UI Server: " << e.what();
 #ifdef Q_OS_WIN
@@ -241,7 +266,7 @@ int main(int argc, char **argv)
                                        QString::fromUtf8(e.what()).toHtmlEscaped()));
 #endif
     }
-    const bool daemon = parser.isSet(QStringLiteral("daemon"));
+    const bool daemon = headless || parser.isSet(QStringLiteral("daemon"));
     if (!daemon && app.isSessionRestored()) {
         app.restoreMainWindow();
     }
@@ -38,10 +38,12 @@
 #include "utils/gui-helper.h"
 #include "utils/qt-cxx20-compat.h"
 
+#include "dialogs/uiserverstatisticsdialog.h"
 #include "dialogs/updatenotification.h"
 
 #include <KXMLGUIFactory>
 #include <QApplication>
+#include <QPointer>
 #include <QSize>
 #include <QLineEdit>
 #include <KActionMenu>
@@ -283,6 +285,17 @@ public:
                                i18n("Error Starting KWatchGnuPG"));
     }
 
+    void showUiServerStatistics()
+    {
+        if (!uiServerStatisticsDialog) {
+            uiServerStatisticsDialog = new Dialogs::UiServerStatisticsDialog(q);
+            uiServerStatisticsDialog->setAttribute(Qt::WA_DeleteOnClose);
+        }
+        uiServerStatisticsDialog->show();
+        uiServerStatisticsDialog->raise();
+        uiServerStatisticsDialog->activateWindow();
+    }
+
     void forceUpdateCheck()
     {
         UpdateNotification::forceUpdateCheck(q);
@@ -378,6 +391,7 @@ private:
     } ui;
     QAction *focusToClickSearchAction = nullptr;
     ClipboardMenu *clipboadMenu = nullptr;
+    QPointer<Dialogs::UiServerStatisticsDialog> uiServerStatisticsDialog;
 };
 
 MainWindow::Private::UI::UI(MainWindow *q)
@@ -391,6 +405,9 @@ MainWindow::Private::UI::UI(MainWindow *q)
     stackWidget->addWidget(searchTab);
 
     new KeyCacheOverlay(mainWidget, q);
+    // the overlay is hidden as soon as the certificates of the last session
+    // are shown, so indicate that the certificates are still being loaded
+    mainLayout->addWidget(new KeyCacheLoadingBanner{mainWidget});
 
     scWidget = new SmartCardWidget{q};
     stackWidget->addWidget(scWidget);
@@ -525,6 +542,11 @@ void MainWindow::Private::setupActions()
             i18nc("@info:tooltip", "Restart the background processes, e.g. after making changes to the configuration."),
             "view-refresh", q, [this](bool) { restartDaemons(); }, {}
         },
+        {
+            "tools_uiserver_statistics", i18nc("@action:inmenu", "UI Server Statistics"),
+            i18nc("@info:tooltip", "Show performance statistics of the connections of other applications to Kleopatra."),
+            nullptr, q, [this](bool) { showUiServerStatistics(); }, {}
+        },
         // Help menu
 #ifdef Q_OS_WIN
         {
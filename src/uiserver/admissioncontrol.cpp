@@ -0,0 +1,119 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    uiserver/admissioncontrol.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "admissioncontrol.h"
+
+#include "settings.h"
+
+#include "kleopatra_debug.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+
+using namespace Kleo;
+
+// static
+AdmissionControl *AdmissionControl::instance()
+{
+    static AdmissionControl control;
+    return &control;
+}
+
+AdmissionControl::Ticket AdmissionControl::admit(const void *waiter, const std::function<void()> &retry)
+{
+    Q_ASSERT(waiter);
+    if (m_reservedFor == waiter) {
+        m_reservedFor = nullptr;
+        ++m_running;
+        // more slots may have been freed while the slot was reserved
+        dispatch();
+        return Ticket(this, [](AdmissionControl *control) { control->release(); });
+    }
+
+    const unsigned int max = maxRunningCommands();
+    const unsigned int busy = m_running + (m_reservedFor ? 1 : 0);
+    if (m_waiters.empty() && (max == 0 || busy < max)) {
+        ++m_running;
+        return Ticket(this, [](AdmissionControl *control) { control->release(); });
+    }
+
+    const bool queued = std::any_of(m_waiters.cbegin(), m_waiters.cend(), [waiter](const Waiter &w) {
+        return w.id == waiter;
+    });
+    if (!queued) {
+        qCDebug(KLEOPATRA_LOG) << "AdmissionControl:" << m_running << "commands running; queueing" << waiter;
+        m_waiters.push_back({waiter, retry});
+    }
+    return Ticket();
+}
+
+void AdmissionControl::cancel(const void *waiter)
+{
+    m_waiters.erase(std::remove_if(m_waiters.begin(), m_waiters.end(), [waiter](const Waiter &w) {
+                        return w.id == waiter;
+                    }),
+                    m_waiters.end());
+    if (m_reservedFor == waiter) {
+        m_reservedFor = nullptr;
+        dispatch();
+    }
+}
+
+void AdmissionControl::release()
+{
+    Q_ASSERT(m_running > 0);
+    --m_running;
+    dispatch();
+}
+
+void AdmissionControl::dispatch()
+{
+    if (m_reservedFor || m_waiters.empty()) {
+        return;
+    }
+    const unsigned int max = maxRunningCommands();
+    if (max != 0 && m_running >= max) {
+        return;
+    }
+    const Waiter next = m_waiters.front();
+    m_waiters.pop_front();
+    m_reservedFor = next.id;
+    QMetaObject::invokeMethod(QCoreApplication::instance(), next.retry, Qt::QueuedConnection);
+}
+
+unsigned int AdmissionControl::runningCommands() const
+{
+    return m_running;
+}
+
+unsigned int AdmissionControl::waitingCommands() const
+{
+    return m_waiters.size() + (m_reservedFor ? 1 : 0);
+}
+
+// static
+unsigned int AdmissionControl::maxConnections()
+{
+    return qMax(Settings{}.maxConnections(), 0);
+}
+
+// static
+unsigned int AdmissionControl::maxCommandsPerConnection()
+{
+    return qMax(Settings{}.maxCommandsPerConnection(), 1);
+}
+
+// static
+unsigned int AdmissionControl::maxRunningCommands()
+{
+    return qMax(Settings{}.maxRunningCommands(), 0);
+}
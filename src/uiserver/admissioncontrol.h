@@ -0,0 +1,75 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    uiserver/admissioncontrol.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+namespace Kleo
+{
+
+/**
+ * Limits the number of UI server commands that run at the same time.
+ *
+ * Commands that cannot be started because the limit is reached are queued
+ * in the order of their arrival. When a running command finishes, the slot
+ * is reserved for the first waiting command.
+ *
+ * The limits are read from the UiServer group of the settings. The class
+ * must only be used from the GUI thread.
+ */
+class AdmissionControl
+{
+public:
+    /**
+     * A running command holds a ticket. Destroying the last copy of the
+     * ticket frees the slot.
+     */
+    using Ticket = std::shared_ptr<void>;
+
+    static AdmissionControl *instance();
+
+    /**
+     * Returns a ticket if a command of @p waiter may be started now.
+     * Otherwise, queues @p waiter and returns a null ticket. @p retry is
+     * called once a slot has been reserved for @p waiter.
+     */
+    Ticket admit(const void *waiter, const std::function<void()> &retry);
+
+    /**
+     * Removes @p waiter from the queue, e.g. because the client has gone
+     * away. A slot reserved for @p waiter is passed on.
+     */
+    void cancel(const void *waiter);
+
+    unsigned int runningCommands() const;
+    unsigned int waitingCommands() const;
+
+    static unsigned int maxConnections();
+    static unsigned int maxCommandsPerConnection();
+    static unsigned int maxRunningCommands();
+
+private:
+    AdmissionControl() = default;
+    void release();
+    void dispatch();
+
+private:
+    struct Waiter {
+        const void *id;
+        std::function<void()> retry;
+    };
+    std::deque<Waiter> m_waiters;
+    const void *m_reservedFor = nullptr;
+    unsigned int m_running = 0;
+};
+
+}
@@ -196,6 +196,16 @@ public:
     {
     public:
         virtual ~Memento() {}
+
+        /**
+         * Returns a rough estimate of the memory used by the memento in
+         * bytes. It is used to limit the memory used by the session data.
+         * The default is a guess for a small memento.
+         */
+        virtual qint64 estimatedSize() const
+        {
+            return 4096;
+        }
     };
 
     template <typename T>
@@ -205,6 +215,16 @@ public:
     public:
         explicit TypedMemento(const T &t) : m_t(t) {}
 
+        qint64 estimatedSize() const override
+        {
+            // e.g. the controllers of the sign/encrypt commands know what they hold
+            if constexpr (requires { m_t->estimatedSize(); }) {
+                return m_t ? m_t->estimatedSize() : 0;
+            } else {
+                return Memento::estimatedSize();
+            }
+        }
+
         const T &get() const
         {
             return m_t;
@@ -308,7 +328,7 @@ private:
     void doApplyWindowID(QWidget *w) const;
 
 private:
-    const std::map< QByteArray, std::shared_ptr<Memento> > &mementos() const;
+    std::map< QByteArray, std::shared_ptr<Memento> > mementos() const;
 
 private:
     friend class ::Kleo::AssuanCommandFactory;
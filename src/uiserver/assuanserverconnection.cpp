@@ -17,10 +17,13 @@
 #include <version-kleopatra.h>
 
 #include "assuanserverconnection.h"
+#include "admissioncontrol.h"
+#include "serverstatistics.h"
 #include "assuancommand.h"
 #include "sessiondata.h"
 
 #include <utils/input.h>
+#include <utils/iodevicelogger.h>
 #include <utils/output.h>
 #include <Libkleo/GnuPG>
 #include <utils/detail_p.h>
@@ -32,8 +35,13 @@
 #include <Libkleo/KleoException>
 #include <Libkleo/KeyCache>
 
+#include <QGpgME/KeyListJob>
+#include <QGpgME/Protocol>
+
+#include <gpgme++/context.h>
 #include <gpgme++/data.h>
 #include <gpgme++/key.h>
+#include <gpgme++/keylistresult.h>
 
 #include <KMime/HeaderParsing>
 
@@ -41,8 +49,11 @@
 #include <KLocalizedString>
 #include <KWindowSystem>
 
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSocketNotifier>
-#include <QTimer>
+#include <QThread>
 #include <QVariant>
 #include <QPointer>
 #include <QFileInfo>
@@ -54,8 +65,10 @@
 
 #include <map>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <type_traits>
+#include <utility>
 
 #include <cerrno>
 
@@ -226,9 +239,6 @@ public Q_SLOTS:
         if (const int err = assuan_process_next(ctx.get(), &done) || done) {
             //if ( err == -1 || gpg_err_code(err) == GPG_ERR_EOF ) {
             topHalfDeletion();
-            if (nohupedCommands.empty()) {
-                bottomHalfDeletion();
-            }
             //} else {
             //assuan_process_done( ctx.get(), err );
             //return;
@@ -236,9 +246,132 @@ public Q_SLOTS:
         }
     }
 
-    int startCommandBottomHalf();
+    void startReading();
+
+public:
+    // The connection lives in its own thread, which parses the client's
+    // requests and owns the assuan context. Commands are created and run in
+    // the GUI thread, because they show dialogs and use the key cache.
+    template <typename Function>
+    void runInGuiThread(Function &&f)
+    {
+        QMetaObject::invokeMethod(QCoreApplication::instance(), std::forward<Function>(f), Qt::QueuedConnection);
+    }
+
+    template <typename Function>
+    void runInConnectionThread(Function &&f)
+    {
+        if (QThread::currentThread() == QObject::thread()) {
+            f();
+        } else {
+            QMetaObject::invokeMethod(this, std::forward<Function>(f), Qt::QueuedConnection);
+        }
+    }
+
+    // Writing to the client happens asynchronously in the connection's
+    // thread, so the first failure is remembered and raised by the next
+    // sendStatus() or sendData() of the command.
+    void setWriteError(gpg_error_t err, const QString &message)
+    {
+        const QMutexLocker locker(&writeErrorMutex);
+        if (!writeError) {
+            writeError = err;
+            writeErrorMessage = message;
+        }
+    }
+
+    gpg_error_t takeWriteError(QString *message)
+    {
+        const QMutexLocker locker(&writeErrorMutex);
+        *message = writeErrorMessage;
+        writeErrorMessage.clear();
+        return std::exchange(writeError, 0);
+    }
+
+    void processDone(gpg_error_t err, const QString &errMsg = QString())
+    {
+        runInConnectionThread([this, err, msg = errMsg.toUtf8()]() {
+            if (!ctx) {
+                return;
+            }
+            if (msg.isEmpty()) {
+                assuan_process_done(ctx.get(), err);
+            } else {
+                assuan_process_done_msg(ctx.get(), err, msg.constData());
+            }
+        });
+    }
+
+    void startCommandBottomHalf();
 
 private:
+    bool startKeyLookup(const AssuanCommand &cmd);
+
+    void keyLookupDone(unsigned int generation, const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys)
+    {
+        if (result.error() && !result.error().isCanceled()) {
+            qCDebug(KLEOPATRA_LOG) << "Key lookup failed:" << QString::fromLocal8Bit(result.error().asString());
+        }
+        KeyCache::mutableInstance()->insert(keys);
+        if (finishKeyLookup(generation)) {
+            startCommandBottomHalf();
+        }
+    }
+
+    // The generation of the key lookups is kept in the upper and the number
+    // of pending key lookups in the lower half of keyLookupState, so that both
+    // are checked and changed in one atomic step. reset() increments the
+    // generation from the connection's thread, while the lookups are started
+    // and finished in the GUI thread.
+    static unsigned int keyLookupGeneration(quint64 state)
+    {
+        return state >> 32;
+    }
+
+    static unsigned int pendingKeyLookups(quint64 state)
+    {
+        return state & 0xffffffff;
+    }
+
+    unsigned int pendingKeyLookupCount() const
+    {
+        return pendingKeyLookups(keyLookupState);
+    }
+
+    // returns the generation of the started lookup
+    unsigned int startKeyLookupJob()
+    {
+        return keyLookupGeneration(keyLookupState.fetch_add(1));
+    }
+
+    // returns true if this was the last pending lookup of the current generation
+    bool finishKeyLookup(unsigned int generation)
+    {
+        quint64 state = keyLookupState;
+        do {
+            if (keyLookupGeneration(state) != generation) {
+                // the lookup was started before the last reset
+                qCDebug(KLEOPATRA_LOG) << "Ignoring result of stale key lookup";
+                return false;
+            }
+            if (pendingKeyLookups(state) == 0) {
+                return false;
+            }
+        } while (!keyLookupState.compare_exchange_weak(state, state - 1));
+        return pendingKeyLookups(state) == 1;
+    }
+
+    // returns the number of pending lookups of the previous generation
+    unsigned int cancelKeyLookups()
+    {
+        quint64 state = keyLookupState;
+        while (!keyLookupState.compare_exchange_weak(state, quint64(keyLookupGeneration(state) + 1) << 32)) {
+        }
+        return pendingKeyLookups(state);
+    }
+
+    void stopThread();
+
     void nohupDone(AssuanCommand *cmd)
     {
         const auto it = std::find_if(nohupedCommands.begin(), nohupedCommands.end(),
@@ -247,24 +380,42 @@ private:
                                      });
         Q_ASSERT(it != nohupedCommands.end());
         nohupedCommands.erase(it);
+        ServerStatistics::instance()->nohupCommandFinished();
+        admissions.erase(cmd);
         if (nohupedCommands.empty() && closed) {
             bottomHalfDeletion();
+        } else if (closingWhenIdle) {
+            closeIfIdle();
         }
     }
 
     void commandDone(AssuanCommand *cmd)
     {
+        admissions.erase(cmd);
         if (!cmd || cmd != currentCommand.get()) {
             return;
         }
         currentCommand.reset();
+        if (closingWhenIdle) {
+            closeIfIdle();
+        }
     }
 
-    void topHalfDeletion()
+    void closeIfIdle()
     {
-        if (currentCommand) {
-            currentCommand->canceled();
+        if (closed || currentCommand || !nohupedCommands.empty()) {
+            return;
         }
+        // the fd and the socket notifiers belong to the connection's thread
+        runInConnectionThread([this]() {
+            if (!closed) {
+                topHalfDeletion();
+            }
+        });
+    }
+
+    void topHalfDeletion()
+    {
         if (fd != ASSUAN_INVALID_FD) {
 #if defined(Q_OS_WIN32)
             CloseHandle(fd);
@@ -274,6 +425,18 @@ private:
         }
         notifiers.clear();
         closed = true;
+        runInGuiThread([that = QPointer<Private>(this)]() {
+            if (!that) {
+                return;
+            }
+            if (that->currentCommand) {
+                that->currentCommand->canceled();
+                that->admissions.erase(that->currentCommand.get());
+            }
+            if (that->nohupedCommands.empty()) {
+                that->bottomHalfDeletion();
+            }
+        });
     }
 
     void bottomHalfDeletion()
@@ -281,6 +444,7 @@ private:
         if (sessionId) {
             SessionDataHandler::instance()->exitSession(sessionId);
         }
+        stopThread();
         cleanup();
         const QPointer<Private> that = this;
         Q_EMIT q->closed(q);
@@ -386,6 +550,8 @@ private:
             ba = conn.dumpRecipients();
         } else if (qstrcmp(line, "x-files") == 0) {
             ba = conn.dumpFiles();
+        } else if (qstrcmp(line, "stats") == 0) {
+            ba = ServerStatistics::instance()->dump() + SessionDataHandler::instance()->dumpStatistics();
         } else {
             static const QString errorString = i18n("Unknown value for WHAT");
             return assuan_process_done_msg(ctx_, gpg_error(GPG_ERR_ASS_PARAMETER), errorString);
@@ -426,6 +592,17 @@ private:
     template <bool in>
     struct Input_or_Output : std::conditional<in, Input, Output> {};
 
+    static void moveToGuiThread(const std::shared_ptr<QIODevice> &device)
+    {
+        if (!device) {
+            return;
+        }
+        if (auto logger = qobject_cast<IODeviceLogger *>(device.get())) {
+            moveToGuiThread(logger->device());
+        }
+        device->moveToThread(QCoreApplication::instance()->thread());
+    }
+
     // format: TAG (FD|FD=\d+|FILE=...)
     template <bool in, typename T_memptr>
     static gpg_error_t IO_handler(assuan_context_t ctx_, char *line_, T_memptr which)
@@ -509,6 +686,10 @@ private:
                 throw gpg_error(GPG_ERR_UNKNOWN_OPTION);
             }
 
+            // the commands use the devices in the GUI thread; they have to
+            // be moved there by the connection's thread, which created them
+            moveToGuiThread(io->ioDevice());
+
             (conn.*which).push_back(io);
 
             if (binOpt && !in) {
@@ -708,6 +889,7 @@ private:
 
     QByteArray dumpMementos() const
     {
+        const QMutexLocker locker(&mementosMutex);
         QByteArray result;
         for (auto it = mementos.begin(), end = mementos.end(); it != end; ++it) {
             char buf[2 + 2 * sizeof(void *) + 2];
@@ -736,7 +918,10 @@ private:
         informativeRecipients = false;
         sessionTitle.clear();
         sessionId = 0;
-        mementos.clear();
+        {
+            const QMutexLocker locker(&mementosMutex);
+            mementos.clear();
+        }
         files.clear();
         std::for_each(inputs.begin(), inputs.end(), std::mem_fn(&Input::finalize));
         inputs.clear();
@@ -745,37 +930,60 @@ private:
         std::for_each(messages.begin(), messages.end(), std::mem_fn(&Input::finalize));
         messages.clear();
         bias = GpgME::UnknownProtocol;
+        // ignore the results of the key lookups that are still running, but
+        // don't leave a command waiting for them
+        if (cancelKeyLookups() > 0) {
+            runInGuiThread([that = QPointer<Private>(this)]() {
+                if (that) {
+                    that->startCommandBottomHalf();
+                }
+            });
+        }
     }
 
     assuan_fd_t fd;
     AssuanContext ctx;
-    bool closed                : 1;
-    bool cryptoCommandsEnabled : 1;
-    bool commandWaitingForCryptoCommandsEnabled : 1;
-    bool currentCommandIsNohup : 1;
+    // atomic: these are accessed from both the GUI thread and the connection's thread
+    std::atomic<bool> closed;
+    std::atomic<bool> cryptoCommandsEnabled;
+    std::atomic<bool> commandWaitingForCryptoCommandsEnabled;
+    std::atomic<bool> currentCommandIsNohup;
+    std::atomic<bool> keysLookedUpForCurrentCommand;
+    bool closingWhenIdle;
     bool informativeSenders;    // address taken, so no : 1
     bool informativeRecipients; // address taken, so no : 1
     GpgME::Protocol bias;
+    std::atomic<quint64> keyLookupState;
     QString sessionTitle;
     unsigned int sessionId;
     std::vector< std::shared_ptr<QSocketNotifier> > notifiers;
     std::vector< std::shared_ptr<AssuanCommandFactory> > factories; // sorted: _detail::ByName<std::less>
     std::shared_ptr<AssuanCommand> currentCommand;
     std::vector< std::shared_ptr<AssuanCommand> > nohupedCommands;
+    std::map<const AssuanCommand *, AdmissionControl::Ticket> admissions; // of the current and the nohup'ed commands
     std::map<std::string, QVariant> options;
     std::vector<KMime::Types::Mailbox> senders, recipients;
     std::vector< std::shared_ptr<Input> > inputs, messages;
     std::vector< std::shared_ptr<Output> > outputs;
     std::vector<QString> files;
+    mutable QMutex mementosMutex;
+    QMutex writeErrorMutex;
+    gpg_error_t writeError;
+    QString writeErrorMessage;
     std::map< QByteArray, std::shared_ptr<AssuanCommand::Memento> > mementos;
+    QThread thread;
 };
 
 void AssuanServerConnection::Private::cleanup()
 {
     Q_ASSERT(nohupedCommands.empty());
+    cancelKeyLookups();
     reset();
     currentCommand.reset();
     currentCommandIsNohup = false;
+    admissions.clear();
+    AdmissionControl::instance()->cancel(this);
+    keysLookedUpForCurrentCommand = false;
     commandWaitingForCryptoCommandsEnabled = false;
     notifiers.clear();
     ctx.reset();
@@ -790,9 +998,13 @@ AssuanServerConnection::Private::Private(assuan_fd_t fd_, const std::vector< std
       cryptoCommandsEnabled(false),
       commandWaitingForCryptoCommandsEnabled(false),
       currentCommandIsNohup(false),
+      keysLookedUpForCurrentCommand(false),
+      closingWhenIdle(false),
       informativeSenders(false),
       informativeRecipients(false),
       bias(GpgME::UnknownProtocol),
+      keyLookupState(0),
+      writeError(0),
       sessionId(0),
       factories(factories_)
 {
@@ -820,24 +1032,6 @@ AssuanServerConnection::Private::Private(assuan_fd_t fd_, const std::vector< std
     FILE *const logFile = Log::instance()->logFile();
     assuan_set_log_stream(ctx.get(), logFile ? logFile : stderr);
 
-    // register FDs with the event loop:
-    assuan_fd_t fds[MAX_ACTIVE_FDS];
-    const int numFDs = assuan_get_active_fds(ctx.get(), FOR_READING, fds, MAX_ACTIVE_FDS);
-    Q_ASSERT(numFDs != -1);   // == 1
-
-    if (!numFDs || fds[0] != fd) {
-        const std::shared_ptr<QSocketNotifier> sn(new QSocketNotifier((intptr_t)fd, QSocketNotifier::Read), std::mem_fn(&QObject::deleteLater));
-        connect(sn.get(), &QSocketNotifier::activated, this, &Private::slotReadActivity);
-        notifiers.push_back(sn);
-    }
-
-    notifiers.reserve(notifiers.size() + numFDs);
-    for (int i = 0; i < numFDs; ++i) {
-        const std::shared_ptr<QSocketNotifier> sn(new QSocketNotifier((intptr_t)fds[i], QSocketNotifier::Read), std::mem_fn(&QObject::deleteLater));
-        connect(sn.get(), &QSocketNotifier::activated, this, &Private::slotReadActivity);
-        notifiers.push_back(sn);
-    }
-
     // register our INPUT/OUTPUT/MESSGAE/FILE handlers:
     if (const gpg_error_t err = assuan_register_command(ctx.get(), "INPUT",  input_handler, ""))
         throw Exception(err, "register \"INPUT\" handler");
@@ -885,11 +1079,59 @@ AssuanServerConnection::Private::Private(assuan_fd_t fd_, const std::vector< std
     if (const gpg_error_t err = assuan_accept(ctx.get())) {
         throw Exception(err, "assuan_accept");
     }
+
+    // from now on, the client's requests are processed in the connection's thread:
+    thread.setObjectName(QStringLiteral("AssuanServerConnection"));
+    moveToThread(&thread);
+    thread.start();
+    QMetaObject::invokeMethod(this, &Private::startReading, Qt::QueuedConnection);
+
+    ServerStatistics::instance()->connectionOpened();
 }
 
 AssuanServerConnection::Private::~Private()
 {
+    stopThread();
     cleanup();
+    ServerStatistics::instance()->connectionClosed();
+}
+
+void AssuanServerConnection::Private::startReading()
+{
+    // register FDs with the event loop of the connection's thread:
+    assuan_fd_t fds[MAX_ACTIVE_FDS];
+    const int numFDs = assuan_get_active_fds(ctx.get(), FOR_READING, fds, MAX_ACTIVE_FDS);
+    Q_ASSERT(numFDs != -1);   // == 1
+
+    if (!numFDs || fds[0] != fd) {
+        const std::shared_ptr<QSocketNotifier> sn(new QSocketNotifier((intptr_t)fd, QSocketNotifier::Read), std::mem_fn(&QObject::deleteLater));
+        connect(sn.get(), &QSocketNotifier::activated, this, &Private::slotReadActivity);
+        notifiers.push_back(sn);
+    }
+
+    notifiers.reserve(notifiers.size() + numFDs);
+    for (int i = 0; i < numFDs; ++i) {
+        const std::shared_ptr<QSocketNotifier> sn(new QSocketNotifier((intptr_t)fds[i], QSocketNotifier::Read), std::mem_fn(&QObject::deleteLater));
+        connect(sn.get(), &QSocketNotifier::activated, this, &Private::slotReadActivity);
+        notifiers.push_back(sn);
+    }
+}
+
+void AssuanServerConnection::Private::stopThread()
+{
+    if (!thread.isRunning()) {
+        return;
+    }
+    if (QObject::thread() == &thread) {
+        // hand the connection back to the GUI thread; the socket notifiers
+        // have to be destroyed in the thread they were created in
+        QMetaObject::invokeMethod(this, [this]() {
+            notifiers.clear();
+            moveToThread(QCoreApplication::instance()->thread());
+        }, Qt::BlockingQueuedConnection);
+    }
+    thread.quit();
+    thread.wait();
 }
 
 AssuanServerConnection::AssuanServerConnection(assuan_fd_t fd, const std::vector< std::shared_ptr<AssuanCommandFactory> > &factories, QObject *p)
@@ -900,6 +1142,12 @@ AssuanServerConnection::AssuanServerConnection(assuan_fd_t fd, const std::vector
 
 AssuanServerConnection::~AssuanServerConnection() {}
 
+void AssuanServerConnection::closeWhenIdle()
+{
+    d->closingWhenIdle = true;
+    d->closeIfIdle();
+}
+
 void AssuanServerConnection::enableCryptoCommands(bool on)
 {
     if (on == d->cryptoCommandsEnabled) {
@@ -907,7 +1155,11 @@ void AssuanServerConnection::enableCryptoCommands(bool on)
     }
     d->cryptoCommandsEnabled = on;
     if (d->commandWaitingForCryptoCommandsEnabled) {
-        QTimer::singleShot(0, d.get(), &Private::startCommandBottomHalf);
+        d->runInGuiThread([that = QPointer<Private>(d.get())]() {
+            if (that) {
+                that->startCommandBottomHalf();
+            }
+        });
     }
 }
 
@@ -925,9 +1177,10 @@ class InquiryHandler : public QObject
     Q_OBJECT
 public:
 
-    explicit InquiryHandler(const char *keyword_, QObject *p = nullptr)
+    explicit InquiryHandler(const char *keyword_, const char *command_, QObject *p = nullptr)
         : QObject(p),
-          keyword(keyword_)
+          keyword(keyword_),
+          command(command_)
     {
 
     }
@@ -936,14 +1189,18 @@ public:
     {
         Q_ASSERT(cb_data);
         auto this_ = static_cast<InquiryHandler *>(cb_data);
-        Q_EMIT this_->signal(rc, QByteArray::fromRawData(reinterpret_cast<const char *>(buffer), buflen), this_->keyword);
+        ServerStatistics::instance()->addBytesIn(this_->command, buflen);
+        // called in the connection's thread; the receiver gets a deep copy of the data
+        Q_EMIT this_->signal(rc, QByteArray(reinterpret_cast<const char *>(buffer), buflen), this_->keyword);
         std::free(buffer);
-        delete this_;
+        this_->deleteLater();
         return 0;
     }
 
 private:
-    const char *keyword;
+    // copied, because the inquiry outlives the caller's buffer
+    const QByteArray keyword;
+    const char *command;
 
 Q_SIGNALS:
     void signal(int rc, const QByteArray &data, const QByteArray &keyword);
@@ -959,9 +1216,26 @@ public:
           informativeSenders(false),
           bias(GpgME::UnknownProtocol),
           done(false),
-          nohup(false)
+          nohup(false),
+          started(false),
+          firstByteSent(false)
+    {
+
+    }
+
+    void recordOutput(qint64 bytes)
     {
+        ServerStatistics *const stats = ServerStatistics::instance();
+        stats->addBytesOut(commandName, bytes);
+        if (!firstByteSent) {
+            firstByteSent = true;
+            stats->firstByteSent(commandName, timer.elapsed());
+        }
+    }
 
+    void recordFinished(ServerStatistics::Outcome outcome)
+    {
+        ServerStatistics::instance()->commandFinished(commandName, timer.elapsed(), outcome, started);
     }
 
     std::map<std::string, QVariant> options;
@@ -975,8 +1249,40 @@ public:
     unsigned int sessionId;
     QByteArray utf8ErrorKeepAlive;
     AssuanContext ctx;
+    QPointer<AssuanServerConnection::Private> connection;
     bool done;
     bool nohup;
+    // for the statistics:
+    const char *commandName = "";
+    QElapsedTimer timer; // started when the command is received
+    bool started;
+    bool firstByteSent;
+
+    // Everything sent to the client goes through the connection's thread.
+    template <typename Function>
+    bool runInConnectionThread(Function &&f) const
+    {
+        if (!connection) {
+            qCDebug(KLEOPATRA_LOG) << "Connection already gone; dropping output to client";
+            return false;
+        }
+        connection->runInConnectionThread(std::forward<Function>(f));
+        return true;
+    }
+
+    // returns the first failed write to the client since the last call
+    gpg_error_t takeWriteError(QString *message) const
+    {
+        return connection ? connection->takeWriteError(message) : 0;
+    }
+
+    void throwWriteError() const
+    {
+        QString message;
+        if (const gpg_error_t err = takeWriteError(&message)) {
+            throw Exception(err, message);
+        }
+    }
 };
 
 AssuanCommand::AssuanCommand()
@@ -992,6 +1298,8 @@ AssuanCommand::~AssuanCommand()
 
 int AssuanCommand::start()
 {
+    d->started = true;
+    ServerStatistics::instance()->commandStarted(d->commandName, d->timer.elapsed());
     try {
         if (const int err = doStart())
             if (!d->done) {
@@ -1023,6 +1331,9 @@ int AssuanCommand::start()
 
 void AssuanCommand::canceled()
 {
+    if (!d->done) {
+        d->recordFinished(ServerStatistics::Canceled);
+    }
     d->done = true;
     doCanceled();
 }
@@ -1067,11 +1378,12 @@ std::vector<U> keys(const std::map<U, V> &map)
 }
 }
 
-const std::map< QByteArray, std::shared_ptr<AssuanCommand::Memento> > &AssuanCommand::mementos() const
+std::map< QByteArray, std::shared_ptr<AssuanCommand::Memento> > AssuanCommand::mementos() const
 {
     // oh, hack :(
     Q_ASSERT(assuan_get_pointer(d->ctx.get()));
     const AssuanServerConnection::Private &conn = *static_cast<AssuanServerConnection::Private *>(assuan_get_pointer(d->ctx.get()));
+    const QMutexLocker locker(&conn.mementosMutex);
     return conn.mementos;
 }
 
@@ -1087,15 +1399,13 @@ bool AssuanCommand::hasMemento(const QByteArray &tag) const
 std::shared_ptr<AssuanCommand::Memento> AssuanCommand::memento(const QByteArray &tag) const
 {
     if (const unsigned int id = sessionId()) {
-        const std::shared_ptr<SessionDataHandler> sdh = SessionDataHandler::instance();
-        const std::shared_ptr<SessionData> sd = sdh->sessionData(id);
-        const auto it = sd->mementos.find(tag);
-        if (it != sd->mementos.end()) {
-            return it->second;
+        if (const std::shared_ptr<Memento> mem = SessionDataHandler::instance()->memento(id, tag)) {
+            return mem;
         }
     }
-    const auto it = mementos().find(tag);
-    if (it == mementos().end()) {
+    const auto connMementos = mementos();
+    const auto it = connMementos.find(tag);
+    if (it == connMementos.end()) {
         return std::shared_ptr<Memento>();
     } else {
         return it->second;
@@ -1117,6 +1427,7 @@ QByteArray AssuanCommand::registerMemento(const QByteArray &tag, const std::shar
     if (const unsigned int id = sessionId()) {
         SessionDataHandler::instance()->sessionData(id)->mementos[tag] = mem;
     } else {
+        const QMutexLocker locker(&conn.mementosMutex);
         conn.mementos[tag] = mem;
     }
     return tag;
@@ -1128,7 +1439,10 @@ void AssuanCommand::removeMemento(const QByteArray &tag)
     Q_ASSERT(assuan_get_pointer(d->ctx.get()));
     AssuanServerConnection::Private &conn = *static_cast<AssuanServerConnection::Private *>(assuan_get_pointer(d->ctx.get()));
 
-    conn.mementos.erase(tag);
+    {
+        const QMutexLocker locker(&conn.mementosMutex);
+        conn.mementos.erase(tag);
+    }
     if (const unsigned int id = sessionId()) {
         SessionDataHandler::instance()->sessionData(id)->mementos.erase(tag);
     }
@@ -1172,9 +1486,16 @@ void AssuanCommand::sendStatusEncoded(const char *keyword, const std::string &te
     if (d->nohup) {
         return;
     }
-    if (const int err = assuan_write_status(d->ctx.get(), keyword, text.c_str())) {
-        throw Exception(err, i18n("Cannot send \"%1\" status", QString::fromLatin1(keyword)));
-    }
+    d->throwWriteError();
+    d->recordOutput(qstrlen(keyword) + 1 + text.size());
+    d->runInConnectionThread([ctx = d->ctx, conn = d->connection, keyword = std::string(keyword), text]() {
+        if (const int err = assuan_write_status(ctx.get(), keyword.c_str(), text.c_str())) {
+            qCDebug(KLEOPATRA_LOG) << "Cannot send" << keyword.c_str() << "status:" << gpg_strerror(err);
+            if (conn) {
+                conn->setWriteError(err, i18n("Cannot send \"%1\" status", QString::fromStdString(keyword)));
+            }
+        }
+    });
 }
 
 void  AssuanCommand::sendData(const QByteArray &data, bool moreToCome)
@@ -1182,13 +1503,24 @@ void  AssuanCommand::sendData(const QByteArray &data, bool moreToCome)
     if (d->nohup) {
         return;
     }
-    if (const gpg_error_t err = assuan_send_data(d->ctx.get(), data.constData(), data.size())) {
-        throw Exception(err, i18n("Cannot send data"));
-    }
-    if (!moreToCome)
-        if (const gpg_error_t err = assuan_send_data(d->ctx.get(), nullptr, 0)) {   // flush
-            throw Exception(err, i18n("Cannot flush data"));
+    d->throwWriteError();
+    d->recordOutput(data.size());
+    d->runInConnectionThread([ctx = d->ctx, conn = d->connection, data, moreToCome]() {
+        if (const gpg_error_t err = assuan_send_data(ctx.get(), data.constData(), data.size())) {
+            qCDebug(KLEOPATRA_LOG) << "Cannot send data:" << gpg_strerror(err);
+            if (conn) {
+                conn->setWriteError(err, i18n("Cannot send data"));
+            }
+            return;
         }
+        if (!moreToCome)
+            if (const gpg_error_t err = assuan_send_data(ctx.get(), nullptr, 0)) {   // flush
+                qCDebug(KLEOPATRA_LOG) << "Cannot flush data:" << gpg_strerror(err);
+                if (conn) {
+                    conn->setWriteError(err, i18n("Cannot flush data"));
+                }
+            }
+    });
 }
 
 int AssuanCommand::inquire(const char *keyword, QObject *receiver, const char *slot, unsigned int maxSize)
@@ -1201,11 +1533,17 @@ int AssuanCommand::inquire(const char *keyword, QObject *receiver, const char *s
         return makeError(GPG_ERR_INV_OP);
     }
 
-    std::unique_ptr<InquiryHandler> ih(new InquiryHandler(keyword, receiver));
+    std::unique_ptr<InquiryHandler> ih(new InquiryHandler(keyword, d->commandName, receiver));
     receiver->connect(ih.get(), SIGNAL(signal(int,QByteArray,QByteArray)), slot);
-    if (const gpg_error_t err = assuan_inquire_ext(d->ctx.get(), keyword,
-                                maxSize, InquiryHandler::handler, ih.get())) {
-        return err;
+    // errors are reported to the receiver, because the inquiry is started
+    // asynchronously in the connection's thread
+    if (!d->runInConnectionThread([ctx = d->ctx, keyword = QByteArray{keyword}, maxSize, ih = ih.get()]() {
+            if (const gpg_error_t err = assuan_inquire_ext(ctx.get(), keyword.constData(),
+                                        maxSize, InquiryHandler::handler, ih)) {
+                InquiryHandler::handler(ih, err, nullptr, 0);
+            }
+        })) {
+        return makeError(GPG_ERR_INV_OP);
     }
     ih.release();
     return 0;
@@ -1216,25 +1554,36 @@ void AssuanCommand::done(const GpgME::Error &err, const QString &details)
     if (d->ctx && !d->done && !details.isEmpty()) {
         qCDebug(KLEOPATRA_LOG) << "Error: " << details;
         d->utf8ErrorKeepAlive = details.toUtf8();
-        if (!d->nohup) {
-            assuan_set_error(d->ctx.get(), err.encodedError(), d->utf8ErrorKeepAlive.constData());
-        }
     }
     done(err);
 }
 
-void AssuanCommand::done(const GpgME::Error &err)
+void AssuanCommand::done(const GpgME::Error &err_)
 {
     if (!d->ctx) {
-        qCDebug(KLEOPATRA_LOG) << err.asString() << ": called with NULL ctx.";
+        qCDebug(KLEOPATRA_LOG) << err_.asString() << ": called with NULL ctx.";
         return;
     }
     if (d->done) {
-        qCDebug(KLEOPATRA_LOG) << err.asString() << ": called twice!";
+        qCDebug(KLEOPATRA_LOG) << err_.asString() << ": called twice!";
         return;
     }
 
+    // done() is called from slots without an exception handler, so a failed
+    // write to the client is reported as the result of the command instead
+    // of being thrown
+    GpgME::Error err = err_;
+    QString writeErrorMessage;
+    if (const gpg_error_t writeError = d->takeWriteError(&writeErrorMessage)) {
+        qCDebug(KLEOPATRA_LOG) << "Error: " << writeErrorMessage;
+        if (!err) {
+            err = GpgME::Error(writeError);
+            d->utf8ErrorKeepAlive = writeErrorMessage.toUtf8();
+        }
+    }
+
     d->done = true;
+    d->recordFinished(!err ? ServerStatistics::Succeeded : err.isCanceled() ? ServerStatistics::Canceled : ServerStatistics::Failed);
 
     std::for_each(d->messages.begin(), d->messages.end(), std::mem_fn(&Input::finalize));
     std::for_each(d->inputs.begin(), d->inputs.end(), std::mem_fn(&Input::finalize));
@@ -1253,10 +1602,18 @@ void AssuanCommand::done(const GpgME::Error &err)
         return;
     }
 
-    const gpg_error_t rc = assuan_process_done(d->ctx.get(), err.encodedError());
-    if (gpg_err_code(rc) != GPG_ERR_NO_ERROR)
-        qFatal("AssuanCommand::done: assuan_process_done returned error %d (%s)",
-               static_cast<int>(rc), gpg_strerror(rc));
+    d->runInConnectionThread([ctx = d->ctx, conn = QPointer<AssuanServerConnection::Private>(&conn), code = err.encodedError(), message = d->utf8ErrorKeepAlive]() {
+        if (!message.isEmpty()) {
+            assuan_set_error(ctx.get(), code, message.constData());
+        }
+        const gpg_error_t rc = assuan_process_done(ctx.get(), code);
+        // the client may have gone away while the command was finishing;
+        // otherwise, give up on this client, but not on the others
+        if (gpg_err_code(rc) != GPG_ERR_NO_ERROR && conn && !conn->closed) {
+            qCDebug(KLEOPATRA_LOG) << "assuan_process_done returned error" << rc << "(" << gpg_strerror(rc) << "); closing connection";
+            conn->topHalfDeletion();
+        }
+    });
 
     d->utf8ErrorKeepAlive.clear();
 
@@ -1321,41 +1678,58 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
         kleo_assert(*it);
         kleo_assert(qstricmp((*it)->name(), commandName) == 0);
 
-        const std::shared_ptr<AssuanCommand> cmd = (*it)->create();
-        kleo_assert(cmd);
-
-        cmd->d->ctx     = conn.ctx;
-        cmd->d->options = conn.options;
-        cmd->d->inputs.swap(conn.inputs);     kleo_assert(conn.inputs.empty());
-        cmd->d->messages.swap(conn.messages); kleo_assert(conn.messages.empty());
-        cmd->d->outputs.swap(conn.outputs);   kleo_assert(conn.outputs.empty());
-        cmd->d->files.swap(conn.files);       kleo_assert(conn.files.empty());
-        cmd->d->senders.swap(conn.senders);   kleo_assert(conn.senders.empty());
-        cmd->d->recipients.swap(conn.recipients); kleo_assert(conn.recipients.empty());
-        cmd->d->informativeRecipients = conn.informativeRecipients;
-        cmd->d->informativeSenders    = conn.informativeSenders;
-        cmd->d->bias                  = conn.bias;
-        cmd->d->sessionTitle          = conn.sessionTitle;
-        cmd->d->sessionId             = conn.sessionId;
+        // collect the command's data here, in the connection's thread...
+        const auto data = std::make_shared<AssuanCommand::Private>();
+        data->timer.start();
+        data->commandName = (*it)->name();
+        ServerStatistics::instance()->commandReceived(data->commandName, qstrlen(commandName) + 1 + qstrlen(line));
+        data->ctx     = conn.ctx;
+        data->connection = &conn;
+        {
+            // a failed write of the previous command must not fail this one
+            QString message;
+            conn.takeWriteError(&message);
+        }
+        data->options = conn.options;
+        data->inputs.swap(conn.inputs);     kleo_assert(conn.inputs.empty());
+        data->messages.swap(conn.messages); kleo_assert(conn.messages.empty());
+        data->outputs.swap(conn.outputs);   kleo_assert(conn.outputs.empty());
+        data->files.swap(conn.files);       kleo_assert(conn.files.empty());
+        data->senders.swap(conn.senders);   kleo_assert(conn.senders.empty());
+        data->recipients.swap(conn.recipients); kleo_assert(conn.recipients.empty());
+        data->informativeRecipients = conn.informativeRecipients;
+        data->informativeSenders    = conn.informativeSenders;
+        data->bias                  = conn.bias;
+        data->sessionTitle          = conn.sessionTitle;
+        data->sessionId             = conn.sessionId;
 
         const std::map<std::string, std::string> cmdline_options = parse_commandline(line);
         for (auto it = cmdline_options.begin(), end = cmdline_options.end(); it != end; ++it) {
-            cmd->d->options[it->first] = QString::fromUtf8(it->second.c_str());
+            data->options[it->first] = QString::fromUtf8(it->second.c_str());
         }
 
         bool nohup = false;
-        if (cmd->d->options.count("nohup")) {
-            if (!cmd->d->options["nohup"].toString().isEmpty()) {
+        if (data->options.count("nohup")) {
+            if (!data->options["nohup"].toString().isEmpty()) {
                 return assuan_process_done_msg(conn.ctx.get(), gpg_error(GPG_ERR_ASS_PARAMETER), "--nohup takes no argument");
             }
             nohup = true;
-            cmd->d->options.erase("nohup");
+            data->options.erase("nohup");
         }
 
-        conn.currentCommand = cmd;
-        conn.currentCommandIsNohup = nohup;
+        // ...but create and run the command in the GUI thread
+        conn.runInGuiThread([that = QPointer<AssuanServerConnection::Private>(&conn), factory = *it, data, nohup]() {
+            if (!that) {
+                return;
+            }
+            const std::shared_ptr<AssuanCommand> cmd = factory->create();
+            Q_ASSERT(cmd);
+            *cmd->d = std::move(*data);
 
-        QTimer::singleShot(0, &conn, &AssuanServerConnection::Private::startCommandBottomHalf);
+            that->currentCommand = cmd;
+            that->currentCommandIsNohup = nohup;
+            that->startCommandBottomHalf();
+        });
 
         return 0;
 
@@ -1368,20 +1742,47 @@ gpg_error_t AssuanCommandFactory::_handle(assuan_context_t ctx, char *line, cons
     }
 }
 
-int AssuanServerConnection::Private::startCommandBottomHalf()
+void AssuanServerConnection::Private::startCommandBottomHalf()
 {
 
     commandWaitingForCryptoCommandsEnabled = currentCommand && !cryptoCommandsEnabled;
 
     if (!cryptoCommandsEnabled) {
-        return 0;
+        return;
     }
 
     const std::shared_ptr<AssuanCommand> cmd = currentCommand;
     if (!cmd) {
-        return 0;
+        AdmissionControl::instance()->cancel(this);
+        return;
     }
 
+    if (!admissions.count(cmd.get())) {
+        // don't let a single client pile up background operations...
+        if (nohupedCommands.size() >= AdmissionControl::maxCommandsPerConnection()) {
+            ServerStatistics::instance()->commandRejected(cmd->name());
+            currentCommand.reset();
+            currentCommandIsNohup = false;
+            processDone(makeGnuPGError(GPG_ERR_EAGAIN), i18n("Too many operations in progress for this connection; try again later"));
+            return;
+        }
+        // ...and queue the command if too many operations are running already
+        AdmissionControl::Ticket ticket = AdmissionControl::instance()->admit(this, [that = QPointer<Private>(this)]() {
+            if (that) {
+                that->startCommandBottomHalf();
+            }
+        });
+        if (!ticket) {
+            return;
+        }
+        admissions[cmd.get()] = ticket;
+    }
+
+    if (pendingKeyLookupCount() > 0 || startKeyLookup(*cmd)) {
+        return;
+    }
+    keysLookedUpForCurrentCommand = false;
+
     currentCommand.reset();
 
     const bool nohup = currentCommandIsNohup;
@@ -1390,36 +1791,88 @@ int AssuanServerConnection::Private::startCommandBottomHalf()
     try {
 
         if (const int err = cmd->start()) {
-            if (cmd->isDone()) {
-                return err;
-            } else {
-                return assuan_process_done(ctx.get(), err);
+            admissions.erase(cmd.get());
+            if (!cmd->isDone()) {
+                processDone(err);
             }
+            return;
         }
 
         if (cmd->isDone()) {
-            return 0;
+            admissions.erase(cmd.get());
+            return;
         }
 
         if (nohup) {
             cmd->setNohup(true);
             nohupedCommands.push_back(cmd);
-            return assuan_process_done_msg(ctx.get(), 0, "Command put in the background to continue executing after connection end.");
+            ServerStatistics::instance()->nohupCommandStarted();
+            processDone(0, QStringLiteral("Command put in the background to continue executing after connection end."));
         } else {
             currentCommand = cmd;
-            return 0;
         }
 
     } catch (const Exception &e) {
-        return assuan_process_done_msg(ctx.get(), e.error_code(), e.message());
+        admissions.erase(cmd.get());
+        processDone(e.error_code(), e.message());
     } catch (const std::exception &e) {
-        return assuan_process_done_msg(ctx.get(), gpg_error(GPG_ERR_UNEXPECTED), e.what());
+        admissions.erase(cmd.get());
+        processDone(gpg_error(GPG_ERR_UNEXPECTED), QString::fromLocal8Bit(e.what()));
     } catch (...) {
-        return assuan_process_done_msg(ctx.get(), gpg_error(GPG_ERR_UNEXPECTED), i18n("Caught unknown exception"));
+        admissions.erase(cmd.get());
+        processDone(gpg_error(GPG_ERR_UNEXPECTED), i18n("Caught unknown exception"));
     }
 
 }
 
+bool AssuanServerConnection::Private::startKeyLookup(const AssuanCommand &cmd)
+{
+    // Once the key cache is initialized, all keys can be found there. Until
+    // then, only list the keys needed by this command instead of making it
+    // wait for the complete key listing.
+    if (keysLookedUpForCurrentCommand || KeyCache::instance()->initialized()) {
+        return false;
+    }
+    keysLookedUpForCurrentCommand = true;
+
+    QStringList patterns;
+    for (const auto *mailboxes : {&cmd.senders(), &cmd.recipients()}) {
+        for (const KMime::Types::Mailbox &mb : *mailboxes) {
+            if (mb.hasAddress()) {
+                patterns.push_back(QString::fromUtf8(mb.address()));
+            }
+        }
+    }
+    patterns.removeDuplicates();
+    if (patterns.empty()) {
+        return false;
+    }
+
+    for (const QGpgME::Protocol *const backend : {QGpgME::openpgp(), QGpgME::smime()}) {
+        QGpgME::KeyListJob *const job = backend->keyListJob(/*remote=*/false, /*includeSigs=*/false, /*validate=*/true);
+        if (!job) {
+            continue;
+        }
+        // include the secret key information needed for the senders
+        QGpgME::Job::context(job)->addKeyListMode(GpgME::WithSecret);
+        // the connection lives in another thread, so use the application as context
+        // count the lookup before it can finish or be canceled by a reset
+        const unsigned int generation = startKeyLookupJob();
+        connect(job, &QGpgME::KeyListJob::result, QCoreApplication::instance(),
+                [that = QPointer<Private>(this), generation](const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys) {
+                    if (that) {
+                        that->keyLookupDone(generation, result, keys);
+                    }
+                });
+        if (const GpgME::Error err = job->start(patterns)) {
+            qCDebug(KLEOPATRA_LOG) << "Starting key lookup failed:" << QString::fromLocal8Bit(err.asString());
+            finishKeyLookup(generation);
+        }
+    }
+    qCDebug(KLEOPATRA_LOG) << "Key cache not yet initialized; looking up keys for" << patterns;
+    return pendingKeyLookupCount() > 0;
+}
+
 //
 //
 // AssuanCommand convenience methods
@@ -33,6 +33,8 @@ public:
 
 public Q_SLOTS:
     void enableCryptoCommands(bool enable = true);
+    // closes the connection now if no command is running, else after the running commands are done
+    void closeWhenIdle();
 
 Q_SIGNALS:
     void closed(Kleo::AssuanServerConnection *which);
@@ -34,11 +34,13 @@
 
 #include <KLocalizedString>
 
+#include <QFile>
 #include <QFileInfo>
 
 #include <gpg-error.h>
 
 #include <memory>
+#include <string>
 
 using namespace Kleo;
 using namespace Kleo::Crypto;
@@ -63,23 +65,35 @@ public:
     }
 
     void checkForErrors() const;
+    void inquireFiles();
+    void finish(int err, const QString &details);
 
 public Q_SLOTS:
     void slotProgress(const QString &what, int current, int total);
     void verificationResult(const GpgME::VerificationResult &);
+    void slotFiles(int err, const QByteArray &data);
+    void slotFileDone(const QString &fileName, int err, const QString &details);
     void slotDone()
     {
-        q->done();
+        finish(0, QString());
     }
     void slotError(int err, const QString &details)
     {
-        q->done(err, details);
+        finish(err, details);
     }
 
 public:
 
 private:
     std::shared_ptr<DecryptVerifyFilesController> controller;
+    // set in streaming mode, if the controller can process files while they arrive
+    AutoDecryptVerifyFilesController *streamingController = nullptr;
+    bool streaming = false;
+    bool inquiryPending = false;
+    bool finished = false;
+    int finishedError = 0;
+    QString finishedDetails;
+    QStringList streamedFiles;
 };
 
 DecryptVerifyCommandFilesBase::DecryptVerifyCommandFilesBase()
@@ -92,12 +106,19 @@ DecryptVerifyCommandFilesBase::~DecryptVerifyCommandFilesBase() {}
 
 int DecryptVerifyCommandFilesBase::doStart()
 {
+    d->streaming = hasOption("stream");
 
     d->checkForErrors();
 
     FileOperationsPreferences prefs;
     if (prefs.autoDecryptVerify()) {
-        d->controller.reset(new AutoDecryptVerifyFilesController());
+        auto controller = new AutoDecryptVerifyFilesController();
+        QObject::connect(controller, &AutoDecryptVerifyFilesController::fileDone, d.get(), &Private::slotFileDone);
+        if (d->streaming) {
+            controller->setStreaming(true);
+            d->streamingController = controller;
+        }
+        d->controller.reset(controller);
     } else {
         d->controller.reset(new DecryptVerifyFilesController(shared_from_this()));
     }
@@ -110,11 +131,136 @@ int DecryptVerifyCommandFilesBase::doStart()
     QObject::connect(d->controller.get(), &DecryptVerifyFilesController::verificationResult,
                      d.get(), &Private::verificationResult, Qt::QueuedConnection);
 
+    if (d->streaming) {
+        // the files are inquired in chunks; an empty chunk ends the list
+        d->streamedFiles = fileNames();
+        d->inquireFiles();
+        if (!d->streamingController) {
+            // the wizard needs all files up front; start once the list is complete
+            return 0;
+        }
+    }
+
     d->controller->start();
 
     return 0;
 }
 
+void DecryptVerifyCommandFilesBase::Private::inquireFiles()
+{
+    if (const int err = q->inquire("FILES", this, SLOT(slotFiles(int,QByteArray)))) {
+        throw Exception(err, i18n("Failed to inquire the list of files"));
+    }
+    inquiryPending = true;
+}
+
+void DecryptVerifyCommandFilesBase::Private::finish(int err, const QString &details)
+{
+    if (inquiryPending) {
+        // the client is still sending files; end the command once the
+        // pending inquiry has been answered
+        finished = true;
+        finishedError = err;
+        finishedDetails = details;
+        return;
+    }
+    if (err) {
+        q->done(err, details);
+    } else {
+        q->done();
+    }
+}
+
+static QStringList decodeFileNames(const QByteArray &data)
+{
+    QStringList fileNames;
+    const auto lines = data.split('\n');
+    for (const QByteArray &line : lines) {
+        const QByteArray trimmed = line.trimmed();
+        if (!trimmed.isEmpty()) {
+            fileNames.push_back(QFile::decodeName(hexdecode(trimmed.constData()).c_str()));
+        }
+    }
+    return fileNames;
+}
+
+void DecryptVerifyCommandFilesBase::Private::slotFiles(int err, const QByteArray &data)
+{
+    inquiryPending = false;
+
+    if (finished) {
+        // the controller is done already, but the client still expects
+        // a FILE_DONE for every file it sent
+        if (!err) {
+            try {
+                const QStringList fileNames = decodeFileNames(data);
+                for (const QString &fileName : fileNames) {
+                    slotFileDone(fileName, makeGnuPGError(GPG_ERR_CANCELED), QString());
+                }
+            } catch (const Exception &e) {
+                finish(e.error(), e.message());
+                return;
+            }
+        }
+        finish(finishedError, finishedDetails);
+        return;
+    }
+    if (err) {
+        controller->cancel();
+        q->done(err);
+        return;
+    }
+
+    try {
+        QStringList files;
+        const QStringList fileNames = decodeFileNames(data);
+        for (const QString &fileName : fileNames) {
+            const QFileInfo fi(fileName);
+            if (!fi.isAbsolute()) {
+                slotFileDone(fileName, makeGnuPGError(GPG_ERR_INV_ARG), i18n("Only absolute file paths are allowed"));
+            } else if (!fi.exists()) {
+                slotFileDone(fileName, makeGnuPGError(GPG_ERR_ENOENT), QString());
+            } else if (!fi.isFile()) {
+                slotFileDone(fileName, makeGnuPGError(GPG_ERR_INV_ARG), i18n("DECRYPT/VERIFY_FILES cannot use directories as input"));
+            } else if (!fi.isReadable()) {
+                slotFileDone(fileName, makeGnuPGError(GPG_ERR_EPERM), QString());
+            } else {
+                files.push_back(fi.absoluteFilePath());
+            }
+        }
+
+        if (data.trimmed().isEmpty()) {
+            // end of the list
+            if (streamingController) {
+                streamingController->endOfFiles();
+            } else if (streamedFiles.empty()) {
+                q->done(makeError(GPG_ERR_ASS_NO_INPUT), i18n("At least one FILE must be present"));
+            } else {
+                controller->setFiles(streamedFiles);
+                controller->start();
+            }
+            return;
+        }
+
+        inquireFiles();
+        if (streamingController) {
+            streamingController->addFiles(files);
+        } else {
+            streamedFiles += files;
+        }
+    } catch (const Exception &e) {
+        controller->cancel();
+        q->done(e.error(), e.message());
+    }
+}
+
+void DecryptVerifyCommandFilesBase::Private::slotFileDone(const QString &fileName, int err, const QString &details)
+{
+    Q_UNUSED(details)
+    q->sendStatusEncoded("FILE_DONE",
+                         hexencode(QFile::encodeName(fileName).constData()) + ' ' + std::to_string(err));
+}
+
 namespace
 {
 
@@ -150,7 +296,7 @@ void DecryptVerifyCommandFilesBase::Private::checkForErrors() const
         throw Kleo::Exception(q->makeError(GPG_ERR_CONFLICT), i18n("OUTPUT present"));
     }
     const QStringList fileNames = q->fileNames();
-    if (fileNames.empty())
+    if (fileNames.empty() && !streaming)
         throw Exception(makeError(GPG_ERR_ASS_NO_INPUT),
                         i18n("At least one FILE must be present"));
     if (!std::all_of(fileNames.cbegin(), fileNames.cend(), is_file()))
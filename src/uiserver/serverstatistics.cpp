@@ -0,0 +1,169 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    uiserver/serverstatistics.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "serverstatistics.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+using namespace Kleo;
+
+namespace
+{
+const char *const latencyNames[] = {"queue_wait", "first_byte", "total"};
+}
+
+void ServerStatistics::Histogram::add(qint64 msecs)
+{
+    const auto it = std::lower_bound(bucketLimits.cbegin(), bucketLimits.cend(), msecs);
+    ++buckets[it - bucketLimits.cbegin()];
+    ++count;
+    sumMSecs += msecs;
+}
+
+// static
+ServerStatistics *ServerStatistics::instance()
+{
+    static ServerStatistics statistics;
+    return &statistics;
+}
+
+void ServerStatistics::connectionOpened()
+{
+    const QMutexLocker locker(&m_mutex);
+    ++m_activeConnections;
+    ++m_totalConnections;
+}
+
+void ServerStatistics::connectionClosed()
+{
+    const QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_activeConnections > 0);
+    --m_activeConnections;
+}
+
+void ServerStatistics::connectionRejected()
+{
+    const QMutexLocker locker(&m_mutex);
+    ++m_rejectedConnections;
+}
+
+void ServerStatistics::commandReceived(const char *command, qint64 bytes)
+{
+    const QMutexLocker locker(&m_mutex);
+    CommandStatistics &stats = m_commands[command];
+    ++stats.received;
+    stats.bytesIn += bytes;
+}
+
+void ServerStatistics::commandRejected(const char *command)
+{
+    const QMutexLocker locker(&m_mutex);
+    ++m_commands[command].rejected;
+}
+
+void ServerStatistics::commandStarted(const char *command, qint64 queueWaitMSecs)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_commands[command].latencies[QueueWait].add(queueWaitMSecs);
+    ++m_runningCommands;
+}
+
+void ServerStatistics::commandFinished(const char *command, qint64 totalMSecs, Outcome outcome, bool started)
+{
+    const QMutexLocker locker(&m_mutex);
+    CommandStatistics &stats = m_commands[command];
+    switch (outcome) {
+    case Succeeded:
+        ++stats.succeeded;
+        break;
+    case Failed:
+        ++stats.failed;
+        break;
+    case Canceled:
+        ++stats.canceled;
+        break;
+    }
+    stats.latencies[Total].add(totalMSecs);
+    if (started) {
+        Q_ASSERT(m_runningCommands > 0);
+        --m_runningCommands;
+    }
+}
+
+void ServerStatistics::firstByteSent(const char *command, qint64 msecs)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_commands[command].latencies[TimeToFirstByte].add(msecs);
+}
+
+void ServerStatistics::nohupCommandStarted()
+{
+    const QMutexLocker locker(&m_mutex);
+    ++m_nohupCommands;
+}
+
+void ServerStatistics::nohupCommandFinished()
+{
+    const QMutexLocker locker(&m_mutex);
+    Q_ASSERT(m_nohupCommands > 0);
+    --m_nohupCommands;
+}
+
+void ServerStatistics::addBytesIn(const char *command, qint64 bytes)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_commands[command].bytesIn += bytes;
+}
+
+void ServerStatistics::addBytesOut(const char *command, qint64 bytes)
+{
+    const QMutexLocker locker(&m_mutex);
+    m_commands[command].bytesOut += bytes;
+}
+
+QByteArray ServerStatistics::dump() const
+{
+    const QMutexLocker locker(&m_mutex);
+
+    QByteArray result;
+    result += "connections active=" + QByteArray::number(m_activeConnections)
+              + " total=" + QByteArray::number(m_totalConnections)
+              + " rejected=" + QByteArray::number(m_rejectedConnections) + '\n';
+    result += "commands running=" + QByteArray::number(m_runningCommands)
+              + " nohup=" + QByteArray::number(m_nohupCommands) + '\n';
+
+    for (const auto &entry : m_commands) {
+        const CommandStatistics &stats = entry.second;
+        const quint64 finished = stats.succeeded + stats.failed + stats.canceled;
+        result += "command=" + entry.first
+                  + " received=" + QByteArray::number(stats.received)
+                  + " rejected=" + QByteArray::number(stats.rejected)
+                  + " ok=" + QByteArray::number(stats.succeeded)
+                  + " errors=" + QByteArray::number(stats.failed)
+                  + " canceled=" + QByteArray::number(stats.canceled)
+                  + " error_rate=" + QByteArray::number(finished ? double(stats.failed) / finished : 0.0, 'f', 4)
+                  + " bytes_in=" + QByteArray::number(stats.bytesIn)
+                  + " bytes_out=" + QByteArray::number(stats.bytesOut) + '\n';
+        for (int i = 0; i < NumLatencies; ++i) {
+            const Histogram &h = stats.latencies[i];
+            result += "latency=" + entry.first + '/' + latencyNames[i]
+                      + " count=" + QByteArray::number(h.count)
+                      + " sum_ms=" + QByteArray::number(h.sumMSecs);
+            for (std::size_t j = 0; j < bucketLimits.size(); ++j) {
+                result += " le_" + QByteArray::number(bucketLimits[j]) + '=' + QByteArray::number(h.buckets[j]);
+            }
+            result += " le_inf=" + QByteArray::number(h.buckets.back()) + '\n';
+        }
+    }
+    return result;
+}
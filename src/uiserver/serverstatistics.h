@@ -0,0 +1,108 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    uiserver/serverstatistics.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QMutex>
+
+#include <array>
+#include <map>
+
+namespace Kleo
+{
+
+/**
+ * Collects performance statistics of the UI server: connection and command
+ * counters, latency histograms and the number of bytes exchanged with the
+ * clients over the assuan channel.
+ *
+ * All functions are thread-safe. The statistics are reported by the
+ * GETINFO stats command and shown in the UI server statistics dialog.
+ */
+class ServerStatistics
+{
+public:
+    enum Latency {
+        QueueWait,       ///< from receiving the command until it is started
+        TimeToFirstByte, ///< from receiving the command until the first status or data line
+        Total,           ///< from receiving the command until it is done
+
+        NumLatencies
+    };
+
+    enum Outcome {
+        Succeeded,
+        Failed,
+        Canceled
+    };
+
+    static ServerStatistics *instance();
+
+    void connectionOpened();
+    void connectionClosed();
+    void connectionRejected();
+
+    void commandReceived(const char *command, qint64 bytes);
+    void commandRejected(const char *command);
+    void commandStarted(const char *command, qint64 queueWaitMSecs);
+    void commandFinished(const char *command, qint64 totalMSecs, Outcome outcome, bool started);
+    void firstByteSent(const char *command, qint64 msecs);
+
+    void nohupCommandStarted();
+    void nohupCommandFinished();
+
+    void addBytesIn(const char *command, qint64 bytes);
+    void addBytesOut(const char *command, qint64 bytes);
+
+    /**
+     * Returns the statistics as lines of the form
+     * "<topic> key=value key=value ...".
+     */
+    QByteArray dump() const;
+
+private:
+    ServerStatistics() = default;
+
+    // upper bounds of the histogram buckets in milliseconds; the last
+    // bucket collects everything above
+    static constexpr std::array<qint64, 15> bucketLimits = {
+        1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 60000
+    };
+
+    struct Histogram {
+        std::array<quint64, bucketLimits.size() + 1> buckets = {};
+        quint64 count = 0;
+        qint64 sumMSecs = 0;
+
+        void add(qint64 msecs);
+    };
+
+    struct CommandStatistics {
+        quint64 received = 0;
+        quint64 rejected = 0;
+        quint64 succeeded = 0;
+        quint64 failed = 0;
+        quint64 canceled = 0;
+        qint64 bytesIn = 0;
+        qint64 bytesOut = 0;
+        std::array<Histogram, NumLatencies> latencies;
+    };
+
+private:
+    mutable QMutex m_mutex;
+    std::map<QByteArray, CommandStatistics> m_commands;
+    unsigned int m_activeConnections = 0;
+    quint64 m_totalConnections = 0;
+    quint64 m_rejectedConnections = 0;
+    unsigned int m_runningCommands = 0;
+    unsigned int m_nohupCommands = 0;
+};
+
+}
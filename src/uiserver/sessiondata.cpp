@@ -11,10 +11,16 @@
 
 #include "sessiondata.h"
 
+#include "settings.h"
+
 #include "kleopatra_debug.h"
 
+#include <QCoreApplication>
 #include <QMutex>
 
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 using namespace Kleo;
 
@@ -25,9 +31,18 @@ static QMutex mutex;
 SessionData::SessionData()
     : mementos(),
       ref(0),
-      ripe(false)
+      lastUsed()
 {
+    lastUsed.start();
+}
 
+qint64 SessionData::estimatedSize() const
+{
+    qint64 size = sizeof(SessionData);
+    for (const auto &entry : mementos) {
+        size += entry.first.size() + (entry.second ? entry.second->estimatedSize() : 0);
+    }
+    return size;
 }
 
 // static
@@ -41,10 +56,18 @@ std::shared_ptr<SessionDataHandler> SessionDataHandler::instance()
 SessionDataHandler::SessionDataHandler()
     : QObject(),
       data(),
-      timer()
+      timer(),
+      hits(0),
+      misses(0),
+      evictions(0),
+      expirations(0)
 {
+    // the handler may be created by a connection thread
+    moveToThread(QCoreApplication::instance()->thread());
+    timer.moveToThread(QCoreApplication::instance()->thread());
     timer.setInterval(GARBAGE_COLLECTION_INTERVAL);
     timer.setSingleShot(false);
+    connect(&timer, &QTimer::timeout, this, &SessionDataHandler::slotCollectGarbage);
 }
 
 void SessionDataHandler::enterSession(unsigned int id)
@@ -53,7 +76,6 @@ void SessionDataHandler::enterSession(unsigned int id)
     const std::shared_ptr<SessionData> sd = sessionDataInternal(id);
     Q_ASSERT(sd);
     ++sd->ref;
-    sd->ripe = false;
 }
 
 void SessionDataHandler::exitSession(unsigned int id)
@@ -63,7 +85,8 @@ void SessionDataHandler::exitSession(unsigned int id)
     Q_ASSERT(sd);
     if (--sd->ref <= 0) {
         sd->ref = 0;
-        sd->ripe = false;
+        // enforce the limits right away, but in the GUI thread
+        QMetaObject::invokeMethod(this, "slotCollectGarbage", Qt::QueuedConnection);
         if (!timer.isActive()) {
             QMetaObject::invokeMethod(&timer, "start", Qt::QueuedConnection);
         }
@@ -78,6 +101,7 @@ std::shared_ptr<SessionData> SessionDataHandler::sessionDataInternal(unsigned in
         const std::shared_ptr<SessionData> sd(new SessionData);
         it = data.insert(it, std::make_pair(id, sd));
     }
+    it->second->lastUsed.restart();
     return it->second;
 }
 
@@ -86,27 +110,92 @@ std::shared_ptr<SessionData> SessionDataHandler::sessionData(unsigned int id) co
     return sessionDataInternal(id);
 }
 
+std::shared_ptr<AssuanCommand::Memento> SessionDataHandler::memento(unsigned int id, const QByteArray &tag) const
+{
+    const auto it = data.find(id);
+    if (it != data.end()) {
+        it->second->lastUsed.restart();
+        const auto mit = it->second->mementos.find(tag);
+        if (mit != it->second->mementos.end()) {
+            ++hits;
+            return mit->second;
+        }
+    }
+    ++misses;
+    return std::shared_ptr<AssuanCommand::Memento>();
+}
+
 void SessionDataHandler::clear()
 {
     data.clear();
 }
 
+QByteArray SessionDataHandler::dumpStatistics() const
+{
+    unsigned int active = 0;
+    unsigned int idle = 0;
+    qint64 idleBytes = 0;
+    for (const auto &entry : data) {
+        if (entry.second->ref) {
+            ++active;
+        } else {
+            ++idle;
+            idleBytes += entry.second->estimatedSize();
+        }
+    }
+    return "sessions active=" + QByteArray::number(active)
+           + " idle=" + QByteArray::number(idle)
+           + " idle_bytes=" + QByteArray::number(idleBytes)
+           + " hits=" + QByteArray::number(hits)
+           + " misses=" + QByteArray::number(misses)
+           + " evictions=" + QByteArray::number(evictions)
+           + " expirations=" + QByteArray::number(expirations) + '\n';
+}
+
 void SessionDataHandler::slotCollectGarbage()
 {
+    const Settings settings;
+    const qint64 timeout = qint64(qMax(settings.sessionIdleTimeout(), 0)) * 1000;
+    const unsigned int maxIdle = qMax(settings.maxIdleSessions(), 0);
+    const qint64 maxBytes = qint64(qMax(settings.maxSessionCacheSize(), 0)) * 1024;
+
     const QMutexLocker locker(&mutex);
-    unsigned int alive = 0;
-    auto it = data.begin(), end = data.end();
-    while (it != end)
-        if (it->second->ripe) {
-            data.erase(it++);
-        } else if (!it->second->ref) {
-            it->second->ripe = true;
+
+    // drop the idle sessions that have expired and collect the others
+    std::vector<std::pair<qint64, unsigned int>> idle; // (idle time, id)
+    qint64 idleBytes = 0;
+    for (auto it = data.begin(), end = data.end(); it != end;) {
+        const SessionData &sd = *it->second;
+        if (sd.ref) {
             ++it;
+        } else if (sd.lastUsed.hasExpired(timeout)) {
+            ++expirations;
+            data.erase(it++);
         } else {
-            ++alive;
+            idle.emplace_back(sd.lastUsed.elapsed(), it->first);
+            idleBytes += sd.estimatedSize();
             ++it;
         }
-    if (alive == data.size()) {
-        QMetaObject::invokeMethod(&timer, "stop", Qt::QueuedConnection);
+    }
+
+    // drop the least recently used sessions until the limits are met
+    std::sort(idle.begin(), idle.end(), std::greater<>());
+    auto lru = idle.cbegin();
+    while (lru != idle.cend()
+           && ((maxIdle && std::size_t(idle.cend() - lru) > maxIdle) || (maxBytes && idleBytes > maxBytes))) {
+        const auto it = data.find(lru->second);
+        idleBytes -= it->second->estimatedSize();
+        data.erase(it);
+        ++evictions;
+        ++lru;
+    }
+    if (lru != idle.cbegin()) {
+        qCDebug(KLEOPATRA_LOG) << "SessionDataHandler: evicted" << (lru - idle.cbegin()) << "idle sessions";
+    }
+
+    if (lru == idle.cend()) {
+        timer.stop();
+    } else {
+        timer.setInterval(int(qBound<qint64>(1000, timeout, GARBAGE_COLLECTION_INTERVAL)));
     }
 }
@@ -13,6 +13,7 @@
 
 #include "assuancommand.h"
 
+#include <QElapsedTimer>
 #include <QTimer>
 
 #include <memory>
@@ -32,10 +33,21 @@ public:
 private:
     friend class ::Kleo::SessionDataHandler;
     SessionData();
+    qint64 estimatedSize() const;
     int ref;
-    bool ripe;
+    QElapsedTimer lastUsed;
 };
 
+/**
+ * Keeps the mementos of the sessions of the UI server clients.
+ *
+ * The data of sessions that are not used by any connection is kept for
+ * the configured idle timeout so that e.g. a PREP_ENCRYPT and the following
+ * ENCRYPT of the same session can share the resolved recipients. If there
+ * are more idle sessions than allowed, or if the idle sessions use more
+ * memory than allowed, the least recently used ones are dropped first.
+ * Sessions that are in use are never dropped.
+ */
 class SessionDataHandler : public QObject
 {
     Q_OBJECT
@@ -48,17 +60,34 @@ public:
 
     std::shared_ptr<SessionData> sessionData(unsigned int) const;
 
+    /**
+     * Returns the memento @p tag of session @p id and counts the lookup
+     * as cache hit or miss.
+     */
+    std::shared_ptr<AssuanCommand::Memento> memento(unsigned int id, const QByteArray &tag) const;
+
     void clear();
 
+    /**
+     * Returns the statistics of the session cache in the format of
+     * ServerStatistics::dump().
+     */
+    QByteArray dumpStatistics() const;
+
 private Q_SLOTS:
     void slotCollectGarbage();
 
 private:
     mutable std::map< unsigned int, std::shared_ptr<SessionData> > data;
     QTimer timer;
+    mutable quint64 hits;
+    mutable quint64 misses;
+    quint64 evictions;
+    quint64 expirations;
 
 private:
     std::shared_ptr<SessionData> sessionDataInternal(unsigned int) const;
+    void collectGarbage();
     SessionDataHandler();
 };
 
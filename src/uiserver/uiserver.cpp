@@ -12,6 +12,8 @@
 #include "uiserver.h"
 #include "uiserver_p.h"
 
+#include "admissioncontrol.h"
+#include "serverstatistics.h"
 #include "sessiondata.h"
 
 #include <utils/detail_p.h>
@@ -117,6 +119,12 @@ void UiServer::stop()
         d->file.remove();
     }
 
+    // clients may keep idle connections open for reuse; don't wait for them
+    const auto connections = d->connections;
+    for (const std::shared_ptr<AssuanServerConnection> &conn : connections) {
+        conn->closeWhenIdle();
+    }
+
     if (isStopped()) {
         SessionDataHandler::instance()->clear();
         Q_EMIT stopped();
@@ -189,6 +197,11 @@ void UiServer::Private::incomingConnection(qintptr fd)
             assuan_sock_close((assuan_fd_t)fd);
             return;
         }
+        const unsigned int maxConnections = AdmissionControl::maxConnections();
+        if (maxConnections && connections.size() >= maxConnections) {
+            ServerStatistics::instance()->connectionRejected();
+            throw Exception(makeGnuPGError(GPG_ERR_EAGAIN), "too many connections; try again later");
+        }
         const std::shared_ptr<AssuanServerConnection> c(new AssuanServerConnection((assuan_fd_t)fd, factories));
         connect(c.get(), &AssuanServerConnection::closed,
                 this, &Private::slotConnectionClosed);
@@ -0,0 +1,109 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/fileiohints.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "fileiohints.h"
+
+#include "fileoperationspreferences.h"
+
+#include "kleopatra_debug.h"
+
+#include <QFile>
+
+#if defined(HAVE_POSIX_FADVISE) || defined(HAVE_FALLOCATE)
+# include <fcntl.h>
+#endif
+#ifndef Q_OS_WIN
+# include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+using namespace Kleo;
+
+bool FileIOHints::enabledForSize(qint64 size)
+{
+    const FileOperationsPreferences prefs;
+    if (!prefs.largeFileIOHints()) {
+        return false;
+    }
+    const qint64 threshold = qint64(qMax(prefs.largeFileIOHintsThreshold(), 0)) * 1024 * 1024;
+    return size >= threshold;
+}
+
+void FileIOHints::adviseSequentialRead(QFile &file)
+{
+#ifdef HAVE_POSIX_FADVISE
+    const int fd = file.handle();
+    if (fd < 0) {
+        return;
+    }
+    if (const int err = posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL)) {
+        qCDebug(KLEOPATRA_LOG) << __func__ << file.fileName() << "failed:" << strerror(err);
+    }
+#else
+    Q_UNUSED(file)
+#endif
+}
+
+void FileIOHints::dropCachedPages(QFile &file, qint64 offset, qint64 length)
+{
+#ifdef HAVE_POSIX_FADVISE
+    const int fd = file.handle();
+    if (fd < 0 || length <= 0) {
+        return;
+    }
+    if (const int err = posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED)) {
+        qCDebug(KLEOPATRA_LOG) << __func__ << file.fileName() << "failed:" << strerror(err);
+    }
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+#endif
+}
+
+bool FileIOHints::preallocate(QFile &file, qint64 size)
+{
+#ifdef HAVE_FALLOCATE
+    const int fd = file.handle();
+    if (fd < 0 || size <= 0) {
+        return false;
+    }
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) != 0) {
+        // EOPNOTSUPP is expected on file systems without extent support
+        qCDebug(KLEOPATRA_LOG) << __func__ << file.fileName() << "failed:" << strerror(errno);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(file)
+    Q_UNUSED(size)
+    return false;
+#endif
+}
+
+void FileIOHints::releasePreallocation(QFile &file)
+{
+#ifdef HAVE_FALLOCATE
+    const int fd = file.handle();
+    if (fd < 0) {
+        return;
+    }
+    file.flush();
+    // truncating to the current size frees the blocks reserved beyond the end of the file
+    if (ftruncate(fd, file.size()) != 0) {
+        qCDebug(KLEOPATRA_LOG) << __func__ << file.fileName() << "failed:" << strerror(errno);
+    }
+#else
+    Q_UNUSED(file)
+#endif
+}
@@ -0,0 +1,52 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/fileiohints.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QtGlobal>
+
+class QFile;
+
+namespace Kleo
+{
+namespace FileIOHints
+{
+
+/**
+ * Returns true, if page cache hints and preallocation shall be used for
+ * files of the given size. This is controlled by the large file settings
+ * of the file operations preferences.
+ */
+bool enabledForSize(qint64 size);
+
+/**
+ * Tells the kernel that @p file is going to be read sequentially.
+ */
+void adviseSequentialRead(QFile &file);
+
+/**
+ * Tells the kernel that the cached pages of the given range of @p file
+ * are no longer needed.
+ */
+void dropCachedPages(QFile &file, qint64 offset, qint64 length);
+
+/**
+ * Reserves disk space for @p size bytes for @p file without changing the
+ * size of the file. Returns false, if preallocation is not supported.
+ */
+bool preallocate(QFile &file, qint64 size);
+
+/**
+ * Releases space reserved with preallocate() beyond the current end of
+ * @p file.
+ */
+void releasePreallocation(QFile &file);
+
+}
+}
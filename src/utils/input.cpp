@@ -13,6 +13,7 @@
 #include "input_p.h"
 
 #include "detail_p.h"
+#include "fileiohints.h"
 #include "kdpipeiodevice.h"
 #include "windowsprocessdevice.h"
 #include "log.h"
@@ -34,8 +35,13 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QProcess>
+#include <QStringView>
+
+#include <algorithm>
+#include <vector>
 
 #include <cerrno>
+#include <cstring>
 
 using namespace Kleo;
 
@@ -99,6 +105,42 @@ private:
 #endif
 };
 
+// drops the pages that have been read from the page cache, so that
+// reading a huge file doesn't evict everybody else's data
+class DropBehindFile : public QFile
+{
+public:
+    using QFile::QFile;
+
+    bool seek(qint64 pos) override
+    {
+        if (!QFile::seek(pos)) {
+            return false;
+        }
+        m_offset = m_dropped = pos;
+        return true;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        const qint64 n = QFile::readData(data, maxSize);
+        if (n > 0) {
+            m_offset += n;
+            if (m_offset - m_dropped >= DropWindow) {
+                FileIOHints::dropCachedPages(*this, m_dropped, m_offset - m_dropped);
+                m_dropped = m_offset;
+            }
+        }
+        return n;
+    }
+
+private:
+    static constexpr qint64 DropWindow = 8 * 1024 * 1024;
+    qint64 m_offset = 0;
+    qint64 m_dropped = 0;
+};
+
 class FileInput : public InputImplBase
 {
 public:
@@ -125,6 +167,47 @@ private:
 };
 
 #ifndef QT_NO_CLIPBOARD
+// Provides the UTF-8 encoding of a text. The text is encoded in chunks
+// while it is read, so that the clipboard's contents are not kept a second
+// time in encoded form.
+class Utf8EncodingDevice : public QIODevice
+{
+public:
+    explicit Utf8EncodingDevice(const QString &text);
+
+    qint64 size() const override
+    {
+        return m_byteOffsets.back();
+    }
+    bool seek(qint64 pos) override;
+    bool atEnd() const override
+    {
+        return QIODevice::atEnd() && m_position >= size();
+    }
+
+    unsigned int classification() const;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *, qint64) override
+    {
+        return -1;
+    }
+
+private:
+    const QByteArray &chunk(int index) const;
+
+private:
+    const QString m_text;
+    // the offsets of the chunks in the text and in its encoding; the last
+    // entries are the sizes of the text and of the encoding
+    std::vector<qsizetype> m_textOffsets;
+    std::vector<qint64> m_byteOffsets;
+    qint64 m_position = 0;
+    mutable int m_cachedChunk = -1;
+    mutable QByteArray m_cachedBytes;
+};
+
 class ClipboardInput : public Input
 {
 public:
@@ -134,12 +217,12 @@ public:
     QString label() const override;
     std::shared_ptr<QIODevice> ioDevice() const override
     {
-        return m_buffer;
+        return m_device;
     }
     unsigned int classification() const override;
     unsigned long long size() const override
     {
-        return m_buffer ? m_buffer->buffer().size() : 0;
+        return m_device ? m_device->size() : 0;
     }
     QString errorString() const override
     {
@@ -148,7 +231,7 @@ public:
 
 private:
     const QClipboard::Mode m_mode;
-    std::shared_ptr<QBuffer> m_buffer;
+    std::shared_ptr<Utf8EncodingDevice> m_device;
 };
 #endif // QT_NO_CLIPBOARD
 
@@ -242,12 +325,16 @@ FileInput::FileInput(const QString &fileName)
     : InputImplBase(),
       m_io(), m_fileName(fileName)
 {
-    std::shared_ptr<QFile> file(new QFile(fileName));
+    const bool useIOHints = FileIOHints::enabledForSize(QFileInfo(fileName).size());
+    std::shared_ptr<QFile> file(useIOHints ? new DropBehindFile(fileName) : new QFile(fileName));
 
     errno = 0;
     if (!file->open(QIODevice::ReadOnly))
         throw Exception(errno ? gpg_error_from_errno(errno) : gpg_error(GPG_ERR_EIO),
                         i18n("Could not open file \"%1\" for reading", fileName));
+    if (useIOHints) {
+        FileIOHints::adviseSequentialRead(*file);
+    }
     m_io = Log::instance()->createIOLogger(file, QStringLiteral("file-in"), Log::Read);
 
 }
@@ -264,6 +351,9 @@ FileInput::FileInput(const std::shared_ptr<QFile> &file)
     if (!file->isOpen() && !file->open(QIODevice::ReadOnly))
         throw Exception(errno ? gpg_error_from_errno(errno) : gpg_error(GPG_ERR_EIO),
                         i18n("Could not open file \"%1\" for reading", m_fileName));
+    if (FileIOHints::enabledForSize(file->size())) {
+        FileIOHints::adviseSequentialRead(*file);
+    }
     m_io = Log::instance()->createIOLogger(file, QStringLiteral("file-in"), Log::Read);
 }
 
@@ -403,23 +493,100 @@ std::shared_ptr<Input> Input::createFromClipboard()
     return std::shared_ptr<Input>(new ClipboardInput(QClipboard::Clipboard));
 }
 
-static QByteArray dataFromClipboard(QClipboard::Mode mode)
+static QString textFromClipboard(QClipboard::Mode mode)
 {
     Q_UNUSED(mode)
     if (QClipboard *const cb = QApplication::clipboard()) {
-        return cb->text().toUtf8();
+        return cb->text();
     } else {
-        return QByteArray();
+        return QString();
+    }
+}
+
+// in characters
+static const qsizetype utf8ChunkSize = 64 * 1024;
+
+Utf8EncodingDevice::Utf8EncodingDevice(const QString &text)
+    : QIODevice(),
+      m_text(text)
+{
+    const QStringView view{m_text};
+    m_textOffsets.push_back(0);
+    m_byteOffsets.push_back(0);
+    qsizetype start = 0;
+    qint64 bytes = 0;
+    while (start < view.size()) {
+        qsizetype end = std::min(start + utf8ChunkSize, view.size());
+        if (end < view.size() && view[end - 1].isHighSurrogate()) {
+            // don't split a surrogate pair
+            ++end;
+        }
+        bytes += view.mid(start, end - start).toUtf8().size();
+        m_textOffsets.push_back(end);
+        m_byteOffsets.push_back(bytes);
+        start = end;
+    }
+}
+
+bool Utf8EncodingDevice::seek(qint64 pos)
+{
+    if (pos < 0 || pos > size()) {
+        return false;
+    }
+    m_position = pos;
+    return QIODevice::seek(pos);
+}
+
+const QByteArray &Utf8EncodingDevice::chunk(int index) const
+{
+    if (index != m_cachedChunk) {
+        const qsizetype start = m_textOffsets[index];
+        m_cachedBytes = QStringView{m_text}.mid(start, m_textOffsets[index + 1] - start).toUtf8();
+        m_cachedChunk = index;
+    }
+    return m_cachedBytes;
+}
+
+qint64 Utf8EncodingDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 read = 0;
+    while (read < maxSize && m_position < size()) {
+        const auto it = std::upper_bound(m_byteOffsets.cbegin(), m_byteOffsets.cend(), m_position);
+        const int index = std::distance(m_byteOffsets.cbegin(), it) - 1;
+        const QByteArray &bytes = chunk(index);
+        const qint64 offset = m_position - m_byteOffsets[index];
+        const qint64 count = std::min(maxSize - read, bytes.size() - offset);
+        memcpy(data + read, bytes.constData() + offset, count);
+        read += count;
+        m_position += count;
+    }
+    return read;
+}
+
+unsigned int Utf8EncodingDevice::classification() const
+{
+    // classify the encoding chunk by chunk; the end of the previous chunk is
+    // prepended, so that a marker spanning two chunks is found, too
+    static const int overlap = 256;
+    static const unsigned int unclassified = classifyContent(QByteArray());
+    QByteArray previousEnd;
+    for (int index = 0; index + 1 < static_cast<int>(m_textOffsets.size()); ++index) {
+        const QByteArray &bytes = chunk(index);
+        const unsigned int result = classifyContent(previousEnd + bytes);
+        if (result != unclassified) {
+            return result;
+        }
+        previousEnd = bytes.right(overlap);
     }
+    return unclassified;
 }
 
 ClipboardInput::ClipboardInput(QClipboard::Mode mode)
     : Input(),
       m_mode(mode),
-      m_buffer(new QBuffer)
+      m_device(new Utf8EncodingDevice(textFromClipboard(mode)))
 {
-    m_buffer->setData(dataFromClipboard(mode));
-    if (!m_buffer->open(QIODevice::ReadOnly))
+    if (!m_device->open(QIODevice::ReadOnly))
         throw Exception(gpg_error(GPG_ERR_EIO),
                         i18n("Could not open clipboard for reading"));
 }
@@ -444,7 +611,7 @@ QString ClipboardInput::label() const
 
 unsigned int ClipboardInput::classification() const
 {
-    return classifyContent(m_buffer->data());
+    return m_device->classification();
 }
 #endif // QT_NO_CLIPBOARD
 
@@ -11,14 +11,126 @@
 
 #include "iodevicelogger.h"
 
+#include "kleopatra_debug.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+
 using namespace Kleo;
 
+namespace
+{
+
+// Writes the logged data in the background, so that logging doesn't
+// slow down the I/O it logs. If the log devices cannot keep up, then
+// data is dropped instead of blocking the data path.
+class LogWriter : public QThread
+{
+public:
+    static LogWriter *instance()
+    {
+        static LogWriter self;
+        return &self;
+    }
+
+    ~LogWriter() override
+    {
+        {
+            const QMutexLocker locker(&m_mutex);
+            m_quit = true;
+            m_cond.wakeOne();
+        }
+        wait();
+    }
+
+    bool enqueue(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 size)
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (m_queuedBytes + size > MaxQueuedBytes) {
+            m_droppedBytes += size;
+            return false;
+        }
+        m_queue.push_back({dev, QByteArray(data, size)});
+        m_queuedBytes += size;
+        if (!isRunning()) {
+            start(QThread::LowPriority);
+        }
+        m_cond.wakeOne();
+        return true;
+    }
+
+    qint64 droppedBytes() const
+    {
+        return m_droppedBytes;
+    }
+
+protected:
+    void run() override
+    {
+        QMutexLocker locker(&m_mutex);
+        while (true) {
+            while (m_queue.empty() && !m_quit) {
+                m_cond.wait(&m_mutex);
+            }
+            if (m_queue.empty()) {
+                return;
+            }
+            const Chunk chunk = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_queuedBytes -= chunk.data.size();
+
+            locker.unlock();
+            write(chunk.dev, chunk.data.constData(), chunk.data.size());
+            locker.relock();
+        }
+    }
+
+private:
+    LogWriter() = default;
+
+    static void write(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 max)
+    {
+        qint64 toWrite = max;
+        while (toWrite > 0) {
+            const qint64 written = dev->write(data, toWrite);
+            if (written < 0) {
+                qCDebug(KLEOPATRA_LOG) << "Writing to the I/O log failed:" << dev->errorString();
+                return;
+            }
+            data += written;
+            toWrite -= written;
+        }
+    }
+
+private:
+    static constexpr qint64 MaxQueuedBytes = 16 * 1024 * 1024;
+
+    struct Chunk {
+        std::shared_ptr<QIODevice> dev;
+        QByteArray data;
+    };
+
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    std::deque<Chunk> m_queue;
+    qint64 m_queuedBytes = 0;
+    std::atomic<qint64> m_droppedBytes{0};
+    bool m_quit = false;
+};
+
+}
+
 class IODeviceLogger::Private
 {
     IODeviceLogger *const q;
 public:
 
-    static bool write(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 max);
+    void write(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 max);
 
     explicit Private(const std::shared_ptr<QIODevice> &io_, IODeviceLogger *qq) : q(qq), io(io_), writeLog(), readLog()
     {
@@ -31,27 +143,35 @@ public:
 
     ~Private()
     {
+        if (droppedBytes > 0) {
+            qCDebug(KLEOPATRA_LOG) << "I/O logger dropped" << droppedBytes << "bytes";
+        }
     }
 
     const std::shared_ptr<QIODevice> io;
     std::shared_ptr<QIODevice> writeLog;
     std::shared_ptr<QIODevice> readLog;
+    qint64 maximumLogSize = 0;
+    qint64 loggedBytes = 0;
+    qint64 droppedBytes = 0;
 };
 
-bool IODeviceLogger::Private::write(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 max)
+void IODeviceLogger::Private::write(const std::shared_ptr<QIODevice> &dev, const char *data, qint64 max)
 {
     Q_ASSERT(dev);
     Q_ASSERT(data);
     Q_ASSERT(max >= 0);
-    qint64 toWrite = max;
-    while (toWrite > 0) {
-        const qint64 written = dev->write(data, toWrite);
-        if (written < 0) {
-            return false;
+    if (maximumLogSize > 0) {
+        max = qMin(max, maximumLogSize - loggedBytes);
+        if (max <= 0) {
+            return;
         }
-        toWrite -= written;
     }
-    return true;
+    if (LogWriter::instance()->enqueue(dev, data, max)) {
+        loggedBytes += max;
+    } else {
+        droppedBytes += max;
+    }
 }
 
 IODeviceLogger::IODeviceLogger(const std::shared_ptr<QIODevice> &iod, QObject *parent) : QIODevice(parent), d(new Private(iod, this))
@@ -62,6 +182,11 @@ IODeviceLogger::~IODeviceLogger()
 {
 }
 
+std::shared_ptr<QIODevice> IODeviceLogger::device() const
+{
+    return d->io;
+}
+
 void IODeviceLogger::setWriteLogDevice(const std::shared_ptr<QIODevice> &dev)
 {
     d->writeLog = dev;
@@ -72,6 +197,27 @@ void IODeviceLogger::setReadLogDevice(const std::shared_ptr<QIODevice> &dev)
     d->readLog = dev;
 }
 
+void IODeviceLogger::setMaximumLogSize(qint64 bytes)
+{
+    d->maximumLogSize = bytes;
+}
+
+qint64 IODeviceLogger::maximumLogSize() const
+{
+    return d->maximumLogSize;
+}
+
+qint64 IODeviceLogger::droppedBytes() const
+{
+    return d->droppedBytes;
+}
+
+// static
+qint64 IODeviceLogger::totalDroppedBytes()
+{
+    return LogWriter::instance()->droppedBytes();
+}
+
 bool IODeviceLogger::atEnd() const
 {
     return d->io->atEnd();
@@ -142,7 +288,7 @@ qint64 IODeviceLogger::readData(char *data, qint64 maxSize)
 {
     const qint64 num = d->io->read(data, maxSize);
     if (num > 0 && d->readLog) {
-        Private::write(d->readLog, data, num);
+        d->write(d->readLog, data, num);
     }
     return num;
 }
@@ -151,7 +297,7 @@ qint64 IODeviceLogger::writeData(const char *data, qint64 maxSize)
 {
     const qint64 num = d->io->write(data, maxSize);
     if (num > 0 && d->writeLog) {
-        Private::write(d->writeLog, data, num);
+        d->write(d->writeLog, data, num);
     }
     return num;
 }
@@ -160,7 +306,7 @@ qint64 IODeviceLogger::readLineData(char *data, qint64 maxSize)
 {
     const qint64 num = d->io->readLine(data, maxSize);
     if (num > 0 && d->readLog) {
-        Private::write(d->readLog, data, num);
+        d->write(d->readLog, data, num);
     }
     return num;
 }
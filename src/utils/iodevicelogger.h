@@ -25,9 +25,32 @@ public:
     explicit IODeviceLogger(const std::shared_ptr<QIODevice> &iod, QObject *parent = nullptr);
     ~IODeviceLogger() override;
 
+    /**
+     * Returns the device whose data is logged.
+     */
+    std::shared_ptr<QIODevice> device() const;
+
     void setWriteLogDevice(const std::shared_ptr<QIODevice> &dev);
     void setReadLogDevice(const std::shared_ptr<QIODevice> &dev);
 
+    /**
+     * Limits the amount of data which is logged to the first @p bytes bytes
+     * of the stream. 0 means no limit.
+     */
+    void setMaximumLogSize(qint64 bytes);
+    qint64 maximumLogSize() const;
+
+    /**
+     * Returns the number of bytes which could not be logged because the
+     * queue of the background writer was full.
+     */
+    qint64 droppedBytes() const;
+
+    /**
+     * Returns the number of bytes dropped by all loggers so far.
+     */
+    static qint64 totalDroppedBytes();
+
     bool atEnd() const override;
     qint64 bytesAvailable() const override;
     qint64 bytesToWrite() const override;
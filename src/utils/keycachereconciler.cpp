@@ -0,0 +1,323 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachereconciler.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keycachereconciler.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/FileSystemWatcher>
+#include <Libkleo/KeyCache>
+
+#include <QGpgME/KeyListJob>
+#include <QGpgME/Protocol>
+
+#include <QHash>
+#include <QStringList>
+
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/keylistresult.h>
+
+#include <chrono>
+
+using namespace Kleo;
+
+namespace
+{
+// if more keys have changed, then reloading all keys is cheaper; this also
+// keeps the command line of gpg and gpgsm short enough for Windows
+static const int MAX_CHANGED_KEYS = 500;
+
+// the properties of a key that are reported by a non-validating listing
+QByteArray keyState(const GpgME::Key &key)
+{
+    // gpgsm computes the validity, and whether a certificate is revoked,
+    // expired or invalid, only by validating the chain, so for CMS these
+    // properties of a non-validating listing differ from the ones of the
+    // cached (validated) keys
+    const bool withValidation = key.protocol() == GpgME::OpenPGP;
+
+    QByteArray state;
+    if (withValidation) {
+        state += key.isRevoked() ? 'r' : '-';
+        state += key.isExpired() ? 'e' : '-';
+        state += key.isInvalid() ? 'i' : '-';
+    }
+    state += key.isDisabled() ? 'd' : '-';
+    state += key.hasSecret() ? 's' : '-';
+    state += char('0' + key.ownerTrust());
+    for (const GpgME::Subkey &subkey : key.subkeys()) {
+        state += ';';
+        state += subkey.fingerprint();
+        if (withValidation) {
+            state += subkey.isRevoked() ? 'r' : '-';
+            state += subkey.isExpired() ? 'e' : '-';
+        }
+        state += QByteArray::number(qint64(subkey.expirationTime()));
+    }
+    for (const GpgME::UserID &uid : key.userIDs()) {
+        state += ';';
+        state += uid.id();
+        if (withValidation) {
+            state += uid.isRevoked() ? 'r' : '-';
+            state += uid.isInvalid() ? 'i' : '-';
+            state += uid.validityAsString();
+        }
+    }
+    return state;
+}
+
+QGpgME::KeyListJob *keyListJob(GpgME::Protocol protocol, bool validate)
+{
+    const QGpgME::Protocol *const backend = protocol == GpgME::OpenPGP ? QGpgME::openpgp() : QGpgME::smime();
+    QGpgME::KeyListJob *const job = backend ? backend->keyListJob(/*remote=*/false, /*includeSigs=*/false, validate) : nullptr;
+    if (job) {
+        QGpgME::Job::context(job)->addKeyListMode(GpgME::WithSecret);
+    }
+    return job;
+}
+}
+
+static KeyCacheReconciler *self = nullptr;
+
+KeyCacheReconciler::KeyCacheReconciler(const std::shared_ptr<FileSystemWatcher> &watcher, QObject *parent)
+    : QObject(parent),
+      m_watcher(watcher)
+{
+    self = this;
+    connect(m_watcher.get(), &FileSystemWatcher::triggered, this, &KeyCacheReconciler::reconcile);
+    connect(KeyCache::instance().get(), &KeyCache::keyListingDone, this, &KeyCacheReconciler::keyListingDone);
+    m_refreshTimer.setSingleShot(true);
+    connect(&m_refreshTimer, &QTimer::timeout, this, [this]() {
+        reload(GpgME::UnknownProtocol);
+    });
+}
+
+KeyCacheReconciler::~KeyCacheReconciler()
+{
+    self = nullptr;
+}
+
+// static
+KeyCacheReconciler *KeyCacheReconciler::instance()
+{
+    return self;
+}
+
+// static
+void KeyCacheReconciler::reloadKeyCache(GpgME::Protocol protocol)
+{
+    if (self) {
+        self->reload(protocol);
+    } else {
+        KeyCache::mutableInstance()->reload(protocol);
+    }
+}
+
+// static
+void KeyCacheReconciler::enableFileSystemWatcher(bool enable)
+{
+    if (self) {
+        self->m_watcherDisabled = !enable;
+        self->updateWatcher();
+    }
+}
+
+void KeyCacheReconciler::setRefreshInterval(unsigned int hours)
+{
+    if (hours == 0) {
+        m_refreshTimer.stop();
+        m_refreshTimer.setInterval(0);
+        return;
+    }
+    m_refreshTimer.setInterval(std::chrono::hours(hours));
+    if (!m_reloading) {
+        m_refreshTimer.start();
+    }
+}
+
+void KeyCacheReconciler::reload(GpgME::Protocol protocol)
+{
+    // compare the next listing with the reloaded keys
+    if (protocol == GpgME::UnknownProtocol) {
+        m_listedStates.clear();
+    } else {
+        m_listedStates.erase(protocol);
+    }
+    m_reloading = true;
+    m_refreshTimer.stop();
+    updateWatcher();
+    KeyCache::mutableInstance()->reload(protocol);
+}
+
+void KeyCacheReconciler::keyListingDone()
+{
+    if (!m_reloading) {
+        return;
+    }
+    m_reloading = false;
+    if (m_refreshTimer.interval() > 0) {
+        m_refreshTimer.start();
+    }
+    updateWatcher();
+}
+
+void KeyCacheReconciler::updateWatcher()
+{
+    m_watcher->setEnabled(!m_running && !m_reloading && !m_watcherDisabled);
+}
+
+void KeyCacheReconciler::reconcile()
+{
+    if (!KeyCache::instance()->initialized() || m_reloading) {
+        // the running key listing will pick up the changes
+        return;
+    }
+    if (m_running) {
+        m_again = true;
+        return;
+    }
+    // listing the keys may update the trust database
+    m_watcher->setEnabled(false);
+    startListing(GpgME::OpenPGP);
+    startListing(GpgME::CMS);
+    updateWatcher();
+}
+
+void KeyCacheReconciler::startListing(GpgME::Protocol protocol)
+{
+    QGpgME::KeyListJob *const job = keyListJob(protocol, /*validate=*/false);
+    if (!job) {
+        return;
+    }
+    connect(job, &QGpgME::KeyListJob::result, this, [this, protocol](const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys) {
+        listingDone(protocol, result, keys);
+    });
+    if (const GpgME::Error err = job->start(QStringList())) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheReconciler: Starting key listing failed:" << QString::fromLocal8Bit(err.asString());
+        return;
+    }
+    ++m_running;
+}
+
+void KeyCacheReconciler::listingDone(GpgME::Protocol protocol, const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys)
+{
+    if (result.error()) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheReconciler: Key listing failed:" << QString::fromLocal8Bit(result.error().asString());
+        reload(protocol);
+        protocolDone();
+        return;
+    }
+
+    QHash<QByteArray, QByteArray> listed;
+    listed.reserve(keys.size());
+    for (const GpgME::Key &key : keys) {
+        listed.insert(QByteArray(key.primaryFingerprint()), keyState(key));
+    }
+
+    std::vector<GpgME::Key> removed;
+    QStringList changed;
+    const auto previous = m_listedStates.find(protocol);
+    if (previous != m_listedStates.end()) {
+        // compare with the previous listing instead of computing the state
+        // of every cached key again
+        const auto cache = KeyCache::instance();
+        for (auto it = previous->second.cbegin(); it != previous->second.cend(); ++it) {
+            const auto listedIt = listed.constFind(it.key());
+            if (listedIt == listed.cend()) {
+                const GpgME::Key key = cache->findByFingerprint(it.key().constData());
+                if (!key.isNull()) {
+                    removed.push_back(key);
+                }
+            } else if (listedIt.value() != it.value()) {
+                changed.push_back(QLatin1String(it.key()));
+            }
+        }
+        for (auto it = listed.cbegin(); it != listed.cend(); ++it) {
+            if (!previous->second.contains(it.key())) {
+                changed.push_back(QLatin1String(it.key()));
+            }
+        }
+    } else {
+        QHash<QByteArray, QByteArray> added = listed;
+        for (const GpgME::Key &key : KeyCache::instance()->keys()) {
+            if (key.protocol() != protocol) {
+                continue;
+            }
+            const auto it = added.find(QByteArray(key.primaryFingerprint()));
+            if (it == added.end()) {
+                removed.push_back(key);
+                continue;
+            }
+            if (it.value() != keyState(key)) {
+                changed.push_back(QLatin1String(key.primaryFingerprint()));
+            }
+            added.erase(it);
+        }
+        // whatever is left has been added
+        for (auto it = added.cbegin(); it != added.cend(); ++it) {
+            changed.push_back(QLatin1String(it.key()));
+        }
+    }
+    m_listedStates[protocol] = std::move(listed);
+
+    qCDebug(KLEOPATRA_LOG) << "KeyCacheReconciler:" << (protocol == GpgME::OpenPGP ? "OpenPGP:" : "CMS:") << removed.size() << "keys removed,"
+                           << changed.size() << "keys added or changed";
+    if (!removed.empty()) {
+        KeyCache::mutableInstance()->remove(removed);
+    }
+    if (changed.empty()) {
+        protocolDone();
+        return;
+    }
+    if (changed.size() > MAX_CHANGED_KEYS) {
+        reload(protocol);
+        protocolDone();
+        return;
+    }
+
+    QGpgME::KeyListJob *const job = keyListJob(protocol, /*validate=*/true);
+    if (!job) {
+        protocolDone();
+        return;
+    }
+    connect(job, &QGpgME::KeyListJob::result, this, [this, protocol](const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys) {
+        lookupDone(protocol, result, keys);
+    });
+    if (const GpgME::Error err = job->start(changed)) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheReconciler: Starting key lookup failed:" << QString::fromLocal8Bit(err.asString());
+        reload(protocol);
+        protocolDone();
+    }
+}
+
+void KeyCacheReconciler::lookupDone(GpgME::Protocol protocol, const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys)
+{
+    if (result.error()) {
+        qCDebug(KLEOPATRA_LOG) << "KeyCacheReconciler: Key lookup failed:" << QString::fromLocal8Bit(result.error().asString());
+        reload(protocol);
+    } else {
+        KeyCache::mutableInstance()->insert(keys);
+    }
+    protocolDone();
+}
+
+void KeyCacheReconciler::protocolDone()
+{
+    if (--m_running > 0) {
+        return;
+    }
+    updateWatcher();
+    if (m_again) {
+        m_again = false;
+        reconcile();
+    }
+}
@@ -0,0 +1,102 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachereconciler.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+#include <gpgme++/global.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+class KeyListResult;
+}
+
+namespace Kleo
+{
+class FileSystemWatcher;
+
+/**
+ * Brings the key cache up to date after the keyrings have been changed by
+ * another program, e.g. by a gpg --import on the command line.
+ *
+ * Instead of reloading all keys, the keys are listed without validating
+ * them and compared with the previous listing, or with the keys in the key
+ * cache after the key cache has been (re)loaded. Only the keys that
+ * have been added or changed are listed again (with validation) and
+ * inserted into the key cache; keys that are gone are removed. If too
+ * many keys have changed, the key cache is reloaded as before.
+ *
+ * The key cache does not know the file system watcher, so the key cache
+ * must be reloaded with reloadKeyCache(), which disables the watcher until
+ * the key listing is done, and the watcher must be disabled with
+ * enableFileSystemWatcher() instead of KeyCache::enableFileSystemWatcher().
+ * For the same reason, the reconciler reloads the key cache periodically
+ * instead of the key cache.
+ */
+class KeyCacheReconciler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit KeyCacheReconciler(const std::shared_ptr<FileSystemWatcher> &watcher, QObject *parent = nullptr);
+    ~KeyCacheReconciler() override;
+
+    static KeyCacheReconciler *instance();
+
+    /**
+     * Reloads the keys of @p protocol like KeyCache::reload(). Validating
+     * the keys may update the trust database, so the file system watcher is
+     * disabled until the key listing is done.
+     */
+    static void reloadKeyCache(GpgME::Protocol protocol = GpgME::UnknownProtocol);
+
+    /**
+     * Enables or disables the file system watcher, e.g. while a command
+     * changes the keyrings and reloads the affected keys itself.
+     */
+    static void enableFileSystemWatcher(bool enable);
+
+    /**
+     * Sets the interval in hours for reloading the key cache. 0 disables
+     * the periodic reloading.
+     */
+    void setRefreshInterval(unsigned int hours);
+
+public Q_SLOTS:
+    void reconcile();
+
+private:
+    void reload(GpgME::Protocol protocol);
+    void keyListingDone();
+    void updateWatcher();
+    void startListing(GpgME::Protocol protocol);
+    void listingDone(GpgME::Protocol protocol, const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys);
+    void lookupDone(GpgME::Protocol protocol, const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys);
+    void protocolDone();
+
+private:
+    std::shared_ptr<FileSystemWatcher> m_watcher;
+    // the states of the keys of the last listing by protocol and fingerprint
+    std::map<GpgME::Protocol, QHash<QByteArray, QByteArray>> m_listedStates;
+    QTimer m_refreshTimer;
+    int m_running = 0;
+    bool m_again = false;
+    bool m_reloading = false;
+    bool m_watcherDisabled = false;
+};
+
+}
@@ -0,0 +1,259 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachesnapshot.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keycachesnapshot.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/KeyCache>
+
+#include <QGpgME/KeyListJob>
+#include <QGpgME/Protocol>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/keylistresult.h>
+
+#include <algorithm>
+#include <iterator>
+
+using namespace Kleo;
+
+namespace
+{
+static const quint32 SNAPSHOT_MAGIC = 0x4b4c4b53; // "KLKS"
+static const quint32 SNAPSHOT_VERSION = 2;
+
+// the certificates are listed by fingerprint on the command line of gpg
+// and gpgsm, so keep the number small enough for Windows
+static const std::size_t MAX_KEYS = 500;
+
+QString snapshotFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/keycache-snapshot");
+}
+
+bool isRelevant(const GpgME::Key &key)
+{
+    if (key.hasSecret()) {
+        return true;
+    }
+    const GpgME::UserID::Validity validity = key.userID(0).validity();
+    return validity == GpgME::UserID::Full || validity == GpgME::UserID::Ultimate;
+}
+}
+
+// static
+KeyCacheSnapshot *KeyCacheSnapshot::instance()
+{
+    static KeyCacheSnapshot snapshot;
+    return &snapshot;
+}
+
+KeyCacheSnapshot::KeyCacheSnapshot()
+    : QObject()
+{
+    // insert the streamed keys in batches, so that the views are not
+    // updated for every single key
+    m_insertTimer.setSingleShot(true);
+    m_insertTimer.setInterval(100);
+    connect(&m_insertTimer, &QTimer::timeout, this, &KeyCacheSnapshot::insertPendingKeys);
+    connect(KeyCache::instance().get(), &KeyCache::keyListingDone, this, [this](const GpgME::KeyListResult &result) {
+        if (!result.error()) {
+            save(KeyCache::instance()->keys());
+        }
+    });
+}
+
+void KeyCacheSnapshot::restore()
+{
+    if (m_pendingListings || KeyCache::instance()->initialized()) {
+        return;
+    }
+
+    QStringList openpgp;
+    QStringList cms;
+    readSnapshot(openpgp, cms);
+    startListing(QGpgME::openpgp(), openpgp);
+    startListing(QGpgME::smime(), cms);
+}
+
+void KeyCacheSnapshot::readSnapshot(QStringList &openpgp, QStringList &cms) const
+{
+    QFile file{snapshotFileName()};
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QDataStream stream{&file};
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != SNAPSHOT_MAGIC || version != SNAPSHOT_VERSION) {
+        qCDebug(KLEOPATRA_LOG) << "Ignoring key cache snapshot with unknown format";
+        return;
+    }
+    stream >> openpgp >> cms;
+    if (stream.status() != QDataStream::Ok) {
+        qCDebug(KLEOPATRA_LOG) << "Ignoring corrupt key cache snapshot";
+        openpgp.clear();
+        cms.clear();
+    }
+}
+
+void KeyCacheSnapshot::startListing(const QGpgME::Protocol *backend, const QStringList &snapshotFingerprints)
+{
+    // listing the secret keys is cheap; it only tells us which certificates
+    // are the user's own, so that they can be listed before all others
+    QGpgME::KeyListJob *const job = backend->keyListJob(/*remote=*/false, /*includeSigs=*/false, /*validate=*/false);
+    if (!job) {
+        return;
+    }
+    connect(job,
+            &QGpgME::KeyListJob::result,
+            this,
+            [this, backend, snapshotFingerprints](const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &secretKeys) {
+                if (result.error() && !result.error().isCanceled()) {
+                    qCDebug(KLEOPATRA_LOG) << "Listing the secret keys failed:" << QString::fromLocal8Bit(result.error().asString());
+                }
+                QStringList own;
+                for (const GpgME::Key &key : secretKeys) {
+                    if (key.primaryFingerprint()) {
+                        own.push_back(QString::fromLatin1(key.primaryFingerprint()));
+                    }
+                }
+                QStringList others;
+                std::copy_if(snapshotFingerprints.cbegin(), snapshotFingerprints.cend(), std::back_inserter(others), [&own](const QString &fpr) {
+                    return !own.contains(fpr);
+                });
+                startStreamingListing(backend, own.mid(0, MAX_KEYS), others);
+                listingFinished();
+            });
+    if (const GpgME::Error err = job->start(QStringList(), /*secretOnly=*/true)) {
+        qCDebug(KLEOPATRA_LOG) << "Listing the secret keys failed:" << QString::fromLocal8Bit(err.asString());
+        return;
+    }
+    ++m_pendingListings;
+}
+
+void KeyCacheSnapshot::startStreamingListing(const QGpgME::Protocol *backend, const QStringList &fingerprints, const QStringList &next)
+{
+    if (fingerprints.empty()) {
+        if (!next.empty()) {
+            startStreamingListing(backend, next, {});
+        }
+        return;
+    }
+    if (KeyCache::instance()->initialized()) {
+        // the complete listing has won the race
+        return;
+    }
+    QGpgME::KeyListJob *const job = backend->keyListJob(/*remote=*/false, /*includeSigs=*/false, /*validate=*/true);
+    if (!job) {
+        return;
+    }
+    QGpgME::Job::context(job)->addKeyListMode(GpgME::WithSecret);
+    connect(job, &QGpgME::KeyListJob::nextKey, this, &KeyCacheSnapshot::addKey);
+    connect(job, &QGpgME::KeyListJob::result, this, [this, backend, next](const GpgME::KeyListResult &result) {
+        if (result.error() && !result.error().isCanceled()) {
+            qCDebug(KLEOPATRA_LOG) << "Listing the keys of the key cache snapshot failed:" << QString::fromLocal8Bit(result.error().asString());
+        }
+        insertPendingKeys();
+        if (!next.empty()) {
+            startStreamingListing(backend, next, {});
+        }
+        listingFinished();
+    });
+    if (const GpgME::Error err = job->start(fingerprints)) {
+        qCDebug(KLEOPATRA_LOG) << "Listing the keys of the key cache snapshot failed:" << QString::fromLocal8Bit(err.asString());
+        return;
+    }
+    ++m_pendingListings;
+}
+
+void KeyCacheSnapshot::addKey(const GpgME::Key &key)
+{
+    m_pendingKeys.push_back(key);
+    if (!m_insertTimer.isActive()) {
+        m_insertTimer.start();
+    }
+}
+
+void KeyCacheSnapshot::insertPendingKeys()
+{
+    m_insertTimer.stop();
+    if (m_pendingKeys.empty()) {
+        return;
+    }
+    std::vector<GpgME::Key> keys;
+    keys.swap(m_pendingKeys);
+    // the complete listing may have won the race
+    if (KeyCache::instance()->initialized()) {
+        return;
+    }
+    KeyCache::mutableInstance()->insert(keys);
+    if (!m_hasInsertedKeys) {
+        m_hasInsertedKeys = true;
+        Q_EMIT firstKeysInserted();
+    }
+}
+
+void KeyCacheSnapshot::listingFinished()
+{
+    if (--m_pendingListings == 0) {
+        qCDebug(KLEOPATRA_LOG) << "Key cache snapshot restored";
+    }
+}
+
+bool KeyCacheSnapshot::hasInsertedKeys() const
+{
+    return m_hasInsertedKeys;
+}
+
+void KeyCacheSnapshot::save(const std::vector<GpgME::Key> &keys)
+{
+    // the user's own certificates first, then those of the contacts they trust
+    std::vector<GpgME::Key> relevant;
+    std::copy_if(keys.cbegin(), keys.cend(), std::back_inserter(relevant), &isRelevant);
+    std::stable_partition(relevant.begin(), relevant.end(), [](const GpgME::Key &key) {
+        return key.hasSecret();
+    });
+    if (relevant.size() > MAX_KEYS) {
+        relevant.resize(MAX_KEYS);
+    }
+
+    QStringList openpgp;
+    QStringList cms;
+    for (const GpgME::Key &key : relevant) {
+        (key.protocol() == GpgME::OpenPGP ? openpgp : cms).push_back(QLatin1String(key.primaryFingerprint()));
+    }
+
+    const QString fileName = snapshotFileName();
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file{fileName};
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCDebug(KLEOPATRA_LOG) << "Writing the key cache snapshot failed:" << file.errorString();
+        return;
+    }
+    QDataStream stream{&file};
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << SNAPSHOT_MAGIC << SNAPSHOT_VERSION << openpgp << cms;
+    if (!file.commit()) {
+        qCDebug(KLEOPATRA_LOG) << "Writing the key cache snapshot failed:" << file.errorString();
+    }
+}
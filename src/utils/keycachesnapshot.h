@@ -0,0 +1,88 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keycachesnapshot.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+
+#include <gpgme++/key.h>
+
+#include <vector>
+
+namespace GpgME
+{
+class KeyListResult;
+}
+
+namespace QGpgME
+{
+class Protocol;
+}
+
+namespace Kleo
+{
+
+/**
+ * Remembers the fingerprints of up to 500 of the most relevant certificates
+ * of the last complete key listing (the user's own certificates first) in a
+ * file in the cache directory. The snapshot does not contain any key data.
+ *
+ * At startup, restore() lists the user's own certificates first and then the
+ * certificates of the snapshot. The keys are inserted into the key cache in
+ * small batches while they are listed, so that the main window can be used
+ * before the complete key listing is done. Until then, the views show only
+ * these certificates. The complete listing then updates the key cache as
+ * usual.
+ *
+ * The certificates are listed live, so a snapshot that is older than the
+ * keyrings is still used; certificates that are gone are simply not found.
+ * The snapshot is only discarded if its format version does not match.
+ */
+class KeyCacheSnapshot : public QObject
+{
+    Q_OBJECT
+public:
+    static KeyCacheSnapshot *instance();
+
+    /**
+     * Starts listing the user's own certificates and the certificates of the
+     * snapshot. Does nothing if the key cache is already initialized.
+     */
+    void restore();
+
+    /**
+     * Returns true if the first certificates have been inserted into the
+     * key cache.
+     */
+    bool hasInsertedKeys() const;
+
+    void save(const std::vector<GpgME::Key> &keys);
+
+Q_SIGNALS:
+    void firstKeysInserted();
+
+private:
+    KeyCacheSnapshot();
+    void readSnapshot(QStringList &openpgp, QStringList &cms) const;
+    void startListing(const QGpgME::Protocol *backend, const QStringList &snapshotFingerprints);
+    void startStreamingListing(const QGpgME::Protocol *backend, const QStringList &fingerprints, const QStringList &next);
+    void addKey(const GpgME::Key &key);
+    void insertPendingKeys();
+    void listingFinished();
+
+private:
+    int m_pendingListings = 0;
+    bool m_hasInsertedKeys = false;
+    std::vector<GpgME::Key> m_pendingKeys;
+    QTimer m_insertTimer;
+};
+
+}
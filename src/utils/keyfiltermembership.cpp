@@ -0,0 +1,199 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyfiltermembership.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keyfiltermembership.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyFilter>
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <gpgme++/key.h>
+
+#include <algorithm>
+
+using namespace Kleo;
+
+void KeyFilterMembership::Entry::set(int number, bool match)
+{
+    if (number >= int(matches.size())) {
+        matches.resize(number + 1);
+        known.resize(number + 1);
+    }
+    matches[number] = match;
+    known[number] = true;
+}
+
+// static
+KeyFilterMembership *KeyFilterMembership::instance()
+{
+    static KeyFilterMembership membership;
+    return &membership;
+}
+
+KeyFilterMembership::KeyFilterMembership()
+    : QObject()
+{
+    const auto cache = KeyCache::instance();
+    connect(cache.get(), &KeyCache::added, this, &KeyFilterMembership::keyAdded);
+    connect(cache.get(), &KeyCache::aboutToRemove, this, &KeyFilterMembership::keyAboutToBeRemoved);
+
+    m_evaluationTimer = new QTimer(this);
+    m_evaluationTimer->setInterval(0);
+    connect(m_evaluationTimer, &QTimer::timeout, this, &KeyFilterMembership::evaluateChunk);
+}
+
+int KeyFilterMembership::number(const GpgME::Key &key)
+{
+    const QByteArray fingerprint{key.primaryFingerprint()};
+    const auto it = m_numbers.constFind(fingerprint);
+    if (it != m_numbers.cend()) {
+        return *it;
+    }
+    const int number = m_numbers.size();
+    m_numbers.insert(fingerprint, number);
+    return number;
+}
+
+void KeyFilterMembership::prepare(const std::shared_ptr<const KeyFilter> &filter)
+{
+    if (!filter) {
+        return;
+    }
+    const auto existing = m_entries.find(filter.get());
+    if (existing != m_entries.end()) {
+        ++existing->second.interested;
+        return;
+    }
+
+    // forget the filters that have been replaced, e.g. by reloading the
+    // key filter configuration
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.filter.use_count() == 1) {
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    Entry &entry = m_entries[filter.get()];
+    entry.filter = filter;
+    entry.interested = 1;
+    entry.snapshot = KeyCache::instance()->keys();
+    if (!m_evaluationTimer->isActive()) {
+        m_evaluationTimer->start();
+    }
+}
+
+void KeyFilterMembership::release(const std::shared_ptr<const KeyFilter> &filter)
+{
+    if (!filter) {
+        return;
+    }
+    const auto it = m_entries.find(filter.get());
+    if (it == m_entries.end()) {
+        return;
+    }
+    Entry &entry = it->second;
+    entry.interested = std::max(entry.interested - 1, 0);
+    if (!entry.ready && entry.interested == 0) {
+        // nobody waits for the result anymore
+        qCDebug(KLEOPATRA_LOG) << "KeyFilterMembership: canceled the evaluation of key filter" << filter->id();
+        m_entries.erase(it);
+    }
+}
+
+void KeyFilterMembership::evaluateChunk()
+{
+    // keep the user interface responsive
+    static const qint64 maxChunkMSecs = 20;
+
+    QElapsedTimer timer;
+    timer.start();
+    for (auto &it : m_entries) {
+        Entry &entry = it.second;
+        if (entry.ready) {
+            continue;
+        }
+        while (entry.next < entry.snapshot.size()) {
+            const GpgME::Key &key = entry.snapshot[entry.next++];
+            entry.set(number(key), entry.filter->matches(key, KeyFilter::Filtering));
+            if (timer.elapsed() >= maxChunkMSecs) {
+                return; // the timer is still running
+            }
+        }
+        for (const GpgME::Key &key : entry.pendingKeys) {
+            entry.set(number(key), entry.filter->matches(key, KeyFilter::Filtering));
+        }
+        entry.pendingKeys.clear();
+        entry.snapshot.clear();
+        entry.ready = true;
+        qCDebug(KLEOPATRA_LOG) << "KeyFilterMembership: evaluated key filter" << entry.filter->id() << "for" << entry.next << "certificates";
+        Q_EMIT ready(entry.filter.get());
+        // the slots may have prepared or released filters
+        return;
+    }
+    m_evaluationTimer->stop();
+}
+
+bool KeyFilterMembership::isReady(const std::shared_ptr<const KeyFilter> &filter) const
+{
+    const auto it = m_entries.find(filter.get());
+    return it != m_entries.end() && it->second.ready;
+}
+
+bool KeyFilterMembership::matches(const std::shared_ptr<const KeyFilter> &filter, const GpgME::Key &key) const
+{
+    const auto it = m_entries.find(filter.get());
+    if (it != m_entries.end() && it->second.ready) {
+        const auto numberIt = m_numbers.constFind(QByteArray{key.primaryFingerprint()});
+        if (numberIt != m_numbers.cend()) {
+            const Entry &entry = it->second;
+            if (*numberIt < int(entry.known.size()) && entry.known[*numberIt]) {
+                return entry.matches[*numberIt];
+            }
+        }
+    }
+    return filter->matches(key, KeyFilter::Filtering);
+}
+
+void KeyFilterMembership::keyAdded(const GpgME::Key &key)
+{
+    // KeyCache also reports updated certificates as added
+    if (m_entries.empty()) {
+        return;
+    }
+    const int n = number(key);
+    for (auto &it : m_entries) {
+        Entry &entry = it.second;
+        if (entry.ready) {
+            entry.set(n, entry.filter->matches(key, KeyFilter::Filtering));
+        } else {
+            entry.pendingKeys.push_back(key);
+        }
+    }
+}
+
+void KeyFilterMembership::keyAboutToBeRemoved(const GpgME::Key &key)
+{
+    const auto it = m_numbers.constFind(QByteArray{key.primaryFingerprint()});
+    if (it == m_numbers.cend()) {
+        return;
+    }
+    for (auto &entry : m_entries) {
+        if (*it < int(entry.second.known.size())) {
+            entry.second.known[*it] = false;
+        }
+    }
+}
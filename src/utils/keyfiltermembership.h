@@ -0,0 +1,104 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keyfiltermembership.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+
+class QTimer;
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+class KeyFilter;
+
+/**
+ * Remembers for every key filter which certificates of the key cache it
+ * matches, so that the views of all tabs share a single evaluation of a
+ * filter per certificate.
+ *
+ * The certificates are numbered, and the results of each filter are kept
+ * in a bitset. prepare() evaluates a filter for all certificates and emits
+ * ready() when done. Afterwards, only certificates that are added to or
+ * updated in the key cache are evaluated again.
+ *
+ * The key filters are not thread-safe, so they are evaluated in the GUI
+ * thread in small chunks that keep the user interface responsive. The
+ * evaluation of a filter is canceled if nobody waits for it anymore, i.e.
+ * if every prepare() has been matched by a release() before it is done.
+ *
+ * The class must only be used from the GUI thread.
+ */
+class KeyFilterMembership : public QObject
+{
+    Q_OBJECT
+public:
+    static KeyFilterMembership *instance();
+
+    /**
+     * Starts evaluating @p filter for all certificates in the key cache
+     * unless this has already been done.
+     */
+    void prepare(const std::shared_ptr<const KeyFilter> &filter);
+
+    /**
+     * Tells that the caller of prepare() is no longer interested in
+     * @p filter.
+     */
+    void release(const std::shared_ptr<const KeyFilter> &filter);
+
+    bool isReady(const std::shared_ptr<const KeyFilter> &filter) const;
+
+    /**
+     * Returns true if @p key matches @p filter. The stored result is used
+     * if there is one; otherwise the filter is evaluated.
+     */
+    bool matches(const std::shared_ptr<const KeyFilter> &filter, const GpgME::Key &key) const;
+
+Q_SIGNALS:
+    void ready(const Kleo::KeyFilter *filter);
+
+private:
+    KeyFilterMembership();
+    int number(const GpgME::Key &key);
+    void keyAdded(const GpgME::Key &key);
+    void keyAboutToBeRemoved(const GpgME::Key &key);
+    void evaluateChunk();
+
+private:
+    struct Entry {
+        std::shared_ptr<const KeyFilter> filter;
+        std::vector<bool> matches;
+        std::vector<bool> known;
+        bool ready = false;
+        int interested = 0;
+        // the certificates to evaluate, and the next one of them
+        std::vector<GpgME::Key> snapshot;
+        std::size_t next = 0;
+        // certificates added while the snapshot is evaluated
+        std::vector<GpgME::Key> pendingKeys;
+
+        void set(int number, bool match);
+    };
+    QHash<QByteArray, int> m_numbers; // primary fingerprint -> number
+    std::map<const KeyFilter *, Entry> m_entries;
+    QTimer *m_evaluationTimer;
+};
+
+}
@@ -0,0 +1,267 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysearchindex.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keysearchindex.h"
+
+#include "tags.h"
+
+#include "kleopatra_debug.h"
+
+#include <Libkleo/Formatting>
+#include <Libkleo/KeyCache>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+
+#include <gpgme++/key.h>
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <numeric>
+#include <unordered_map>
+
+using namespace Kleo;
+
+struct KeySearchIndex::Documents {
+    std::vector<QString> texts; // case-folded
+    QHash<QByteArray, int> numbers; // primary fingerprint -> document number
+    std::unordered_map<quint64, std::vector<int>> trigrams;
+    // upper-case fingerprints, and reversed for looking up key IDs
+    std::vector<std::pair<QByteArray, int>> fingerprints;
+    std::vector<std::pair<QByteArray, int>> reversedFingerprints;
+};
+
+namespace
+{
+// shorter hex strings are more likely meant as text
+static const int MIN_HEX_DIGITS = 8;
+
+quint64 trigram(const QChar *s)
+{
+    return (quint64(s[0].unicode()) << 32) | (quint64(s[1].unicode()) << 16) | quint64(s[2].unicode());
+}
+
+QString searchText(const GpgME::Key &key, const std::vector<GpgME::Key> &tagKeys)
+{
+    // the fields are separated by newlines, so that a query cannot match
+    // across fields
+    QStringList fields;
+    fields.push_back(QString::fromLatin1(key.primaryFingerprint()));
+    for (const GpgME::UserID &uid : key.userIDs()) {
+        fields.push_back(Formatting::prettyName(uid));
+        fields.push_back(Formatting::prettyEMail(uid));
+        fields.push_back(QString::fromUtf8(uid.id()));
+        if (!tagKeys.empty()) {
+            GpgME::Error err;
+            for (const std::string &remark : uid.remarks(tagKeys, err)) {
+                fields.push_back(QString::fromStdString(remark));
+            }
+        }
+    }
+    return fields.join(QLatin1Char('\n')).toCaseFolded();
+}
+
+// returns the hex digits of query in upper case if query consists only of
+// hex digits and spaces
+QByteArray hexDigits(const QString &query)
+{
+    QByteArray result;
+    result.reserve(query.size());
+    for (const QChar c : query) {
+        if (c == QLatin1Char(' ')) {
+            continue;
+        }
+        if (!isxdigit(c.toLatin1())) {
+            return {};
+        }
+        result.push_back(c.toUpper().toLatin1());
+    }
+    return result.size() >= MIN_HEX_DIGITS ? result : QByteArray();
+}
+
+void addPrefixMatches(const std::vector<std::pair<QByteArray, int>> &sorted, const QByteArray &prefix, std::vector<int> &matches)
+{
+    auto it = std::lower_bound(sorted.cbegin(), sorted.cend(), prefix, [](const std::pair<QByteArray, int> &entry, const QByteArray &value) {
+        return entry.first < value;
+    });
+    for (; it != sorted.cend() && it->first.startsWith(prefix); ++it) {
+        matches.push_back(it->second);
+    }
+}
+
+std::vector<int> trigramCandidates(const KeySearchIndex::Documents &documents, const QString &query)
+{
+    std::vector<const std::vector<int> *> postings;
+    for (int i = 0; i + 3 <= query.size(); ++i) {
+        const auto it = documents.trigrams.find(trigram(query.constData() + i));
+        if (it == documents.trigrams.cend()) {
+            return {};
+        }
+        postings.push_back(&it->second);
+    }
+    std::sort(postings.begin(), postings.end(), [](const std::vector<int> *lhs, const std::vector<int> *rhs) {
+        return lhs->size() < rhs->size();
+    });
+    std::vector<int> candidates = *postings.front();
+    std::vector<int> intersection;
+    for (auto it = std::next(postings.cbegin()); it != postings.cend() && !candidates.empty(); ++it) {
+        intersection.clear();
+        std::set_intersection(candidates.cbegin(), candidates.cend(), (*it)->cbegin(), (*it)->cend(), std::back_inserter(intersection));
+        candidates.swap(intersection);
+    }
+    return candidates;
+}
+}
+
+bool KeySearchIndex::Result::contains(const GpgME::Key &key) const
+{
+    if (m_query.isEmpty()) {
+        return true;
+    }
+    if (m_documents && key.primaryFingerprint()) {
+        const auto it = m_documents->numbers.constFind(QByteArray{key.primaryFingerprint()});
+        if (it != m_documents->numbers.cend()) {
+            return m_matched[*it];
+        }
+    }
+    if (searchText(key, {}).contains(m_query)) {
+        return true;
+    }
+    const QByteArray hex = hexDigits(m_query);
+    return !hex.isEmpty() && key.primaryFingerprint() && QByteArray{key.primaryFingerprint()}.toUpper().contains(hex);
+}
+
+// static
+KeySearchIndex *KeySearchIndex::instance()
+{
+    static KeySearchIndex index;
+    return &index;
+}
+
+KeySearchIndex::KeySearchIndex()
+    : QObject()
+{
+    const auto cache = KeyCache::instance();
+    connect(cache.get(), &KeyCache::added, this, &KeySearchIndex::invalidate);
+    connect(cache.get(), &KeyCache::aboutToRemove, this, &KeySearchIndex::invalidate);
+    connect(cache.get(), &KeyCache::keysMayHaveChanged, this, [this]() {
+        invalidate();
+        Q_EMIT changed();
+    });
+}
+
+void KeySearchIndex::invalidate()
+{
+    m_documents.reset();
+    m_lastResult.reset();
+}
+
+std::shared_ptr<const KeySearchIndex::Documents> KeySearchIndex::documents()
+{
+    if (m_documents) {
+        return m_documents;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const std::vector<GpgME::Key> keys = KeyCache::instance()->keys();
+    const std::vector<GpgME::Key> tagKeys = Tags::tagsEnabled() ? Tags::tagKeys() : std::vector<GpgME::Key>{};
+    auto documents = std::make_shared<Documents>();
+    documents->texts.reserve(keys.size());
+    documents->numbers.reserve(keys.size());
+    documents->fingerprints.reserve(keys.size());
+    documents->reversedFingerprints.reserve(keys.size());
+    for (const GpgME::Key &key : keys) {
+        if (!key.primaryFingerprint()) {
+            continue;
+        }
+        const int number = documents->texts.size();
+        const QByteArray fingerprint = QByteArray{key.primaryFingerprint()}.toUpper();
+        documents->texts.push_back(searchText(key, tagKeys));
+        documents->numbers.insert(QByteArray{key.primaryFingerprint()}, number);
+        documents->fingerprints.emplace_back(fingerprint, number);
+        QByteArray reversedFingerprint = fingerprint;
+        std::reverse(reversedFingerprint.begin(), reversedFingerprint.end());
+        documents->reversedFingerprints.emplace_back(reversedFingerprint, number);
+
+        const QString &text = documents->texts.back();
+        for (int i = 0; i + 3 <= text.size(); ++i) {
+            // the document numbers are increasing, so checking the last
+            // entry is enough to keep the posting lists free of duplicates
+            std::vector<int> &postings = documents->trigrams[trigram(text.constData() + i)];
+            if (postings.empty() || postings.back() != number) {
+                postings.push_back(number);
+            }
+        }
+    }
+    std::sort(documents->fingerprints.begin(), documents->fingerprints.end());
+    std::sort(documents->reversedFingerprints.begin(), documents->reversedFingerprints.end());
+
+    qCDebug(KLEOPATRA_LOG) << "KeySearchIndex: indexed" << documents->texts.size() << "certificates in" << timer.elapsed() << "ms";
+    m_documents = documents;
+    return m_documents;
+}
+
+
+std::shared_ptr<const KeySearchIndex::Result> KeySearchIndex::search(const QString &query)
+{
+    const QString foldedQuery = query.toCaseFolded();
+    if (m_lastResult && m_lastResult->m_query == foldedQuery && m_lastResult->m_documents == m_documents) {
+        return m_lastResult;
+    }
+
+    const std::shared_ptr<const Documents> docs = documents();
+    auto result = std::make_shared<Result>();
+    result->m_query = foldedQuery;
+    result->m_documents = docs;
+
+    std::vector<int> candidates;
+    if (m_lastResult && m_lastResult->m_documents == docs && foldedQuery.contains(m_lastResult->m_query)) {
+        // refine the matches of the previous query
+        candidates = m_lastResult->m_matches;
+    } else if (foldedQuery.size() >= 3) {
+        candidates = trigramCandidates(*docs, foldedQuery);
+    } else {
+        candidates.resize(docs->texts.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+    }
+    std::copy_if(candidates.cbegin(), candidates.cend(), std::back_inserter(result->m_matches), [&docs, &foldedQuery](int number) {
+        return docs->texts[number].contains(foldedQuery);
+    });
+
+    // fingerprints are usually written in groups separated by spaces
+    const QByteArray hex = hexDigits(query);
+    if (!hex.isEmpty()) {
+        addPrefixMatches(docs->fingerprints, hex, result->m_matches);
+        QByteArray reversedHex = hex;
+        std::reverse(reversedHex.begin(), reversedHex.end());
+        addPrefixMatches(docs->reversedFingerprints, reversedHex, result->m_matches);
+        std::sort(result->m_matches.begin(), result->m_matches.end());
+        result->m_matches.erase(std::unique(result->m_matches.begin(), result->m_matches.end()), result->m_matches.end());
+    }
+
+    result->m_matched.resize(docs->texts.size());
+    for (int number : result->m_matches) {
+        result->m_matched[number] = true;
+    }
+
+    m_lastResult = result;
+    return m_lastResult;
+}
+
+// static
+bool KeySearchIndex::matches(const QString &text, const QString &query)
+{
+    return text.toCaseFolded().contains(query.toCaseFolded());
+}
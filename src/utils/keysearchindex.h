@@ -0,0 +1,101 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysearchindex.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+class Key;
+}
+
+namespace Kleo
+{
+
+/**
+ * A search index over the certificates in the key cache.
+ *
+ * For every certificate, the names, email addresses, user IDs, fingerprint
+ * and remarks are case-folded and indexed by trigrams. A query is answered
+ * by intersecting the posting lists of its trigrams and checking only the
+ * remaining candidates. Queries that look like (parts of) fingerprints or
+ * key IDs, possibly with the usual grouping spaces, are looked up in a
+ * sorted list of fingerprints. If a query extends the previous one, only
+ * the matches of the previous query are checked.
+ *
+ * The index is rebuilt lazily by the first search after the key cache has
+ * changed. It must only be used from the GUI thread.
+ */
+class KeySearchIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Documents;
+
+    class Result
+    {
+    public:
+        const QString &query() const
+        {
+            return m_query;
+        }
+
+        /**
+         * Returns true if @p key matches the query. Certificates that are
+         * not in the index, e.g. because they are not in the key cache,
+         * are checked directly.
+         */
+        bool contains(const GpgME::Key &key) const;
+
+    private:
+        friend class KeySearchIndex;
+        QString m_query;
+        std::shared_ptr<const Documents> m_documents;
+        std::vector<int> m_matches; // sorted document numbers
+        std::vector<bool> m_matched;
+    };
+
+    static KeySearchIndex *instance();
+
+    /**
+     * Returns the certificates matching @p query. The match is a
+     * case-insensitive substring match like the one of the filter line
+     * edit of the search bar.
+     */
+    std::shared_ptr<const Result> search(const QString &query);
+
+    /**
+     * Returns true if @p text contains @p query when both are compared
+     * case-insensitively.
+     */
+    static bool matches(const QString &text, const QString &query);
+
+Q_SIGNALS:
+    /**
+     * Emitted when the certificates in the key cache have changed, so that
+     * the results of earlier searches may be outdated.
+     */
+    void changed();
+
+private:
+    KeySearchIndex();
+    void invalidate();
+    std::shared_ptr<const Documents> documents();
+
+private:
+    std::shared_ptr<const Documents> m_documents;
+    std::shared_ptr<const Result> m_lastResult;
+};
+
+}
@@ -0,0 +1,84 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysortcache.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keysortcache.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyList>
+#include <Libkleo/KeyListModelInterface>
+
+#include <QModelIndex>
+#include <QVariant>
+
+using namespace Kleo;
+
+// static
+KeySortCache *KeySortCache::instance()
+{
+    static KeySortCache cache;
+    return &cache;
+}
+
+KeySortCache::KeySortCache()
+    : QObject()
+{
+    const auto cache = KeyCache::instance();
+    // KeyCache also reports updated certificates as added
+    connect(cache.get(), &KeyCache::added, this, &KeySortCache::forget);
+    connect(cache.get(), &KeyCache::aboutToRemove, this, &KeySortCache::forget);
+}
+
+// static
+bool KeySortCache::isCached(int column)
+{
+    return column == KeyList::PrettyName || column == KeyList::PrettyEMail;
+}
+
+std::optional<int> KeySortCache::compare(const KeyListModelInterface *model, const QModelIndex &left, const QModelIndex &right)
+{
+    const GpgME::Key leftKey = model->key(left);
+    const GpgME::Key rightKey = model->key(right);
+    if (!leftKey.primaryFingerprint() || !rightKey.primaryFingerprint()) {
+        return std::nullopt;
+    }
+    // the entries are nodes, so the reference to the left text stays valid
+    // if looking up the right one inserts an entry
+    const QString &leftText = text(leftKey, left);
+    const QString &rightText = text(rightKey, right);
+    // comparing the case-folded texts is equivalent to a case-insensitive
+    // comparison, but cheaper
+    return QString::compare(leftText, rightText, Qt::CaseSensitive);
+}
+
+const QString &KeySortCache::text(const GpgME::Key &key, const QModelIndex &index)
+{
+    Entry &entry = m_entries[key.impl()];
+    if (entry.key.isNull()) {
+        entry.key = key;
+        m_keyData.insert(QByteArray{key.primaryFingerprint()}, key.impl());
+    }
+    const int i = (index.column() == KeyList::PrettyName) ? 0 : 1;
+    if (!entry.known[i]) {
+        entry.texts[i] = index.data(Qt::DisplayRole).toString().toCaseFolded();
+        entry.known[i] = true;
+    }
+    return entry.texts[i];
+}
+
+void KeySortCache::forget(const GpgME::Key &key)
+{
+    const QByteArray fingerprint{key.primaryFingerprint()};
+    const auto keyData = m_keyData.values(fingerprint);
+    for (gpgme_key_t data : keyData) {
+        m_entries.erase(data);
+    }
+    m_keyData.remove(fingerprint);
+}
@@ -0,0 +1,75 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    utils/keysortcache.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QMultiHash>
+#include <QString>
+
+#include <gpgme++/key.h>
+
+#include <optional>
+#include <unordered_map>
+
+class QModelIndex;
+
+namespace Kleo
+{
+
+class KeyListModelInterface;
+
+/**
+ * The case-folded names and email addresses of the certificates, shared by
+ * all key list views, so that sorting by these columns does not ask the
+ * model for the texts on every comparison.
+ *
+ * The entries are looked up by the key data of the certificates, which is
+ * kept alive by the cache, so that a lookup neither allocates nor hashes the
+ * fingerprint. The entries of a certificate are dropped when the key cache
+ * reports it as added, which includes updates, or as about to be removed.
+ *
+ * It must only be used from the GUI thread.
+ */
+class KeySortCache : public QObject
+{
+public:
+    static KeySortCache *instance();
+
+    /**
+     * Returns true if the texts of @p column are cached.
+     */
+    static bool isCached(int column);
+
+    /**
+     * Compares the display texts of @p left and @p right of @p model like
+     * QString::compare() with Qt::CaseInsensitive, i.e. like
+     * QSortFilterProxyModel with case-insensitive, not locale-aware sorting.
+     * Returns std::nullopt if one of the indexes does not refer to a
+     * certificate.
+     */
+    std::optional<int> compare(const KeyListModelInterface *model, const QModelIndex &left, const QModelIndex &right);
+
+private:
+    struct Entry {
+        GpgME::Key key;
+        QString texts[2];
+        bool known[2] = {false, false};
+    };
+
+    KeySortCache();
+    const QString &text(const GpgME::Key &key, const QModelIndex &index);
+    void forget(const GpgME::Key &key);
+
+private:
+    std::unordered_map<gpgme_key_t, Entry> m_entries;
+    QMultiHash<QByteArray, gpgme_key_t> m_keyData; // primary fingerprint -> key data
+};
+
+}
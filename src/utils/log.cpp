@@ -22,6 +22,7 @@
 #include <QFile>
 #include <QString>
 
+#include <atomic>
 
 using namespace Kleo;
 
@@ -32,6 +33,9 @@ public:
     explicit Private(Log *qq) : q(qq), m_ioLoggingEnabled(false), m_logFile(nullptr) {}
     ~Private();
     bool m_ioLoggingEnabled;
+    unsigned int m_ioLoggingSampleRate = 1;
+    qint64 m_ioLoggingLimit = 0;
+    mutable std::atomic<unsigned int> m_streamCounter{0};
     QString m_outputDirectory;
     FILE *m_logFile;
 };
@@ -106,6 +110,26 @@ bool Log::ioLoggingEnabled() const
     return d->m_ioLoggingEnabled;
 }
 
+unsigned int Log::ioLoggingSampleRate() const
+{
+    return d->m_ioLoggingSampleRate;
+}
+
+void Log::setIOLoggingSampleRate(unsigned int n)
+{
+    d->m_ioLoggingSampleRate = qMax(n, 1U);
+}
+
+qint64 Log::ioLoggingLimit() const
+{
+    return d->m_ioLoggingLimit;
+}
+
+void Log::setIOLoggingLimit(qint64 bytes)
+{
+    d->m_ioLoggingLimit = bytes;
+}
+
 QString Log::outputDirectory() const
 {
     return d->m_outputDirectory;
@@ -128,8 +152,12 @@ std::shared_ptr<QIODevice> Log::createIOLogger(const std::shared_ptr<QIODevice>
     if (!d->m_ioLoggingEnabled) {
         return io;
     }
+    if (d->m_streamCounter++ % d->m_ioLoggingSampleRate != 0) {
+        return io;
+    }
 
     std::shared_ptr<IODeviceLogger> logger(new IODeviceLogger(io));
+    logger->setMaximumLogSize(d->m_ioLoggingLimit);
 
     const QString timestamp = QDateTime::currentDateTime().toString(QStringLiteral("yyMMdd-hhmmss"));
 
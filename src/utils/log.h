@@ -41,6 +41,14 @@ public:
     bool ioLoggingEnabled() const;
     void setIOLoggingEnabled(bool enabled);
 
+    /** Only every n-th stream is logged if I/O logging is enabled. */
+    unsigned int ioLoggingSampleRate() const;
+    void setIOLoggingSampleRate(unsigned int n);
+
+    /** Only the first @p bytes bytes of each stream are logged. 0 means no limit. */
+    qint64 ioLoggingLimit() const;
+    void setIOLoggingLimit(qint64 bytes);
+
     QString outputDirectory() const;
     void setOutputDirectory(const QString &path);
 
@@ -13,8 +13,10 @@
 #include "input_p.h"
 #include "detail_p.h"
 #include "kleo_assert.h"
+#include "fileiohints.h"
 #include "kdpipeiodevice.h"
 #include "log.h"
+#include "path-helper.h"
 #include "cached.h"
 
 #include <Libkleo/KleoException>
@@ -40,6 +42,7 @@
 #endif
 
 #include <cerrno>
+#include <utility>
 
 using namespace Kleo;
 using namespace Kleo::_detail;
@@ -88,10 +91,21 @@ public:
         if (isOpen())
         {
             m_oldFileName = fileName();
+            if (m_preallocated) {
+                FileIOHints::releasePreallocation(*this);
+                m_preallocated = false;
+            }
         }
         QTemporaryFile::close();
     }
 
+    void preallocate(qint64 size)
+    {
+        if (isOpen()) {
+            m_preallocated = FileIOHints::preallocate(*this, size);
+        }
+    }
+
     bool openNonInheritable()
     {
         if (!QTemporaryFile::open()) {
@@ -114,6 +128,7 @@ public:
 
 private:
     QString m_oldFileName;
+    bool m_preallocated = false;
 };
 
 template <typename T_IODevice>
@@ -386,6 +401,12 @@ public:
     {
         return m_fileName;
     }
+    void reserve(unsigned long long size) override
+    {
+        if (m_tmpFile && FileIOHints::enabledForSize(size)) {
+            m_tmpFile->preallocate(size);
+        }
+    }
 
     void attachInput(const std::shared_ptr<OutputInput> &input)
     {
@@ -403,6 +424,32 @@ private:
 };
 
 #ifndef QT_NO_CLIPBOARD
+// Decodes the written UTF-8 while it is written, so that the output for the
+// clipboard is not kept both encoded and decoded.
+class Utf8DecodingDevice : public QIODevice
+{
+public:
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+    // returns the decoded text and resets the device
+    QString takeText();
+
+protected:
+    qint64 readData(char *, qint64) override
+    {
+        return -1;
+    }
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    QString m_text;
+    // an incomplete multi-byte sequence at the end of the last write
+    QByteArray m_pending;
+};
+
 class ClipboardOutput : public OutputImplBase
 {
 public:
@@ -411,7 +458,7 @@ public:
     QString label() const override;
     std::shared_ptr<QIODevice> ioDevice() const override
     {
-        return m_buffer;
+        return m_device;
     }
     void doFinalize() override;
     void doCancel() override {}
@@ -423,7 +470,7 @@ private:
     }
 private:
     const QClipboard::Mode m_mode;
-    std::shared_ptr<QBuffer> m_buffer;
+    std::shared_ptr<Utf8DecodingDevice> m_device;
 };
 #endif // QT_NO_CLIPBOARD
 
@@ -583,32 +630,21 @@ void FileOutput::doFinalize()
                     QStringLiteral("Could not find temporary file \"%1\".").arg(tmpFileName));
         }
     }
-    qCDebug(KLEOPATRA_LOG) << this << " renaming " << tmpFileName << "->" << m_fileName;
+    if (QFile::exists(m_fileName)) {
+        qCDebug(KLEOPATRA_LOG) << this << m_fileName << "exists";
 
-    if (QFile::rename(tmpFileName, m_fileName)) {
-        qCDebug(KLEOPATRA_LOG) << this << "succeeded";
+        if (!obtainOverwritePermission())
+            throw Exception(gpg_error(GPG_ERR_CANCELED),
+                            i18n("Overwriting declined"));
 
-        if (!m_attachedInput.expired()) {
-            m_attachedInput.lock()->outputFinalized();
-        }
-        return;
+        qCDebug(KLEOPATRA_LOG) << this << "going to overwrite" << m_fileName;
     }
 
-    qCDebug(KLEOPATRA_LOG) << this << "failed";
-
-    if (!obtainOverwritePermission())
-        throw Exception(gpg_error(GPG_ERR_CANCELED),
-                        i18n("Overwriting declined"));
-
-    qCDebug(KLEOPATRA_LOG) << this << "going to overwrite" << m_fileName;
-
-    if (!QFile::remove(m_fileName))
-        throw Exception(errno ? gpg_error_from_errno(errno) : gpg_error(GPG_ERR_EIO),
-                        i18n("Could not remove file \"%1\" for overwriting.", m_fileName));
-
-    qCDebug(KLEOPATRA_LOG) << this << "succeeded, renaming " << tmpFileName << "->" << m_fileName;
+    qCDebug(KLEOPATRA_LOG) << this << " renaming " << tmpFileName << "->" << m_fileName;
 
-    if (QFile::rename(tmpFileName, m_fileName)) {
+    // the temporary file is created next to the target, so that this is usually an atomic
+    // rename which replaces an existing file instead of a remove followed by a copy
+    if (replaceFile(tmpFileName, m_fileName)) {
         qCDebug(KLEOPATRA_LOG) << this << "succeeded";
 
         if (!m_attachedInput.expired()) {
@@ -694,13 +730,45 @@ std::shared_ptr<Output> Output::createFromClipboard()
     return std::shared_ptr<Output>(new ClipboardOutput(QClipboard::Clipboard));
 }
 
+qint64 Utf8DecodingDevice::writeData(const char *data, qint64 size)
+{
+    QByteArray bytes = m_pending;
+    bytes.append(data, size);
+    // keep a multi-byte sequence that is not yet complete for the next write
+    int complete = bytes.size();
+    for (int i = 1; i <= 3 && i <= bytes.size(); ++i) {
+        const auto c = static_cast<uchar>(bytes[bytes.size() - i]);
+        if ((c & 0xC0) == 0x80) {
+            // continuation byte
+            continue;
+        }
+        if (c >= 0xC0) {
+            const int length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : 2;
+            if (length > i) {
+                complete = bytes.size() - i;
+            }
+        }
+        break;
+    }
+    m_text += QString::fromUtf8(bytes.constData(), complete);
+    m_pending = bytes.mid(complete);
+    return size;
+}
+
+QString Utf8DecodingDevice::takeText()
+{
+    m_text += QString::fromUtf8(m_pending);
+    m_pending.clear();
+    return std::exchange(m_text, QString());
+}
+
 ClipboardOutput::ClipboardOutput(QClipboard::Mode mode)
     : OutputImplBase(),
       m_mode(mode),
-      m_buffer(new QBuffer)
+      m_device(new Utf8DecodingDevice)
 {
     errno = 0;
-    if (!m_buffer->open(QIODevice::WriteOnly))
+    if (!m_device->open(QIODevice::WriteOnly))
         throw Exception(errno ? gpg_error_from_errno(errno) : gpg_error(GPG_ERR_EIO),
                         i18n("Could not write to clipboard"));
 }
@@ -720,11 +788,11 @@ QString ClipboardOutput::label() const
 
 void ClipboardOutput::doFinalize()
 {
-    if (m_buffer->isOpen()) {
-        m_buffer->close();
+    if (m_device->isOpen()) {
+        m_device->close();
     }
     if (QClipboard *const cb = QApplication::clipboard()) {
-        cb->setText(QString::fromUtf8(m_buffer->data()));
+        cb->setText(m_device->takeText());
     } else
         throw Exception(gpg_error(GPG_ERR_EIO),
                         i18n("Could not find clipboard"));
@@ -64,6 +64,8 @@ public:
     /** Whether or not the output failed. */
     virtual bool failed() const { return false; }
     virtual QString fileName() const { return {}; }
+    /** Hint that approximately @p size bytes are going to be written. */
+    virtual void reserve(unsigned long long size) { Q_UNUSED(size) }
 
     static std::shared_ptr<Output> createFromFile(const QString &fileName, const std::shared_ptr<OverwritePolicy> &);
     static std::shared_ptr<Output> createFromFile(const QString &fileName, bool forceOverwrite);
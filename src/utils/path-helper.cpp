@@ -24,6 +24,18 @@
 #include <QFileInfo>
 #include <QDir>
 
+#ifdef Q_OS_WIN
+# include <windows.h>
+#else
+# include <cerrno>
+# include <cstdio>
+#endif
+#ifdef Q_OS_LINUX
+# include <linux/fs.h>
+# include <sys/ioctl.h>
+# include <unistd.h>
+#endif
+
 #include <algorithm>
 
 using namespace Kleo;
@@ -141,7 +153,7 @@ bool Kleo::recursivelyCopy(const QString &src,const QString &dest)
     for(const auto &file: srcDir.entryList(QDir::Files)) {
         const QString srcName = src + QLatin1Char('/') + file;
         const QString destName = dest + QLatin1Char('/') + file;
-        if(!QFile::copy(srcName, destName)) {
+        if(!copyFile(srcName, destName)) {
             return false;
         }
     }
@@ -176,3 +188,83 @@ bool Kleo::moveDir(const QString &src, const QString &dest)
 
     return true;
 }
+
+#ifdef Q_OS_LINUX
+static bool copyFileInKernel(QFile &in, QFile &out)
+{
+#ifdef FICLONE
+    if (ioctl(out.handle(), FICLONE, in.handle()) == 0) {
+        return true;
+    }
+#endif
+#ifdef HAVE_COPY_FILE_RANGE
+    qint64 remaining = in.size();
+    while (remaining > 0) {
+        const ssize_t n = copy_file_range(in.handle(), nullptr, out.handle(), nullptr, remaining, 0);
+        if (n <= 0) {
+            // e.g. EXDEV on older kernels or ENOSYS; let the caller fall back to a plain copy
+            return false;
+        }
+        remaining -= n;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+#endif
+
+bool Kleo::copyFile(const QString &src, const QString &dest)
+{
+#ifdef Q_OS_LINUX
+    if (QFile::exists(dest)) {
+        return false;
+    }
+    QFile in(src);
+    QFile out(dest);
+    if (in.open(QIODevice::ReadOnly) && out.open(QIODevice::WriteOnly)) {
+        if (copyFileInKernel(in, out)) {
+            out.setPermissions(in.permissions());
+            return true;
+        }
+        qCDebug(KLEOPATRA_LOG) << "Copying" << src << "in the kernel failed. Falling back to QFile::copy";
+        out.close();
+        out.remove();
+    }
+#endif
+    return QFile::copy(src, dest);
+}
+
+bool Kleo::replaceFile(const QString &src, const QString &dest)
+{
+#ifdef Q_OS_WIN
+    if (MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(src).utf16()),
+                    reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(dest).utf16()),
+                    MOVEFILE_REPLACE_EXISTING)) {
+        return true;
+    }
+    if (GetLastError() != ERROR_NOT_SAME_DEVICE) {
+        return false;
+    }
+#else
+    // unlike QFile::rename, rename(2) atomically replaces an existing destination
+    if (::rename(QFile::encodeName(src).constData(), QFile::encodeName(dest).constData()) == 0) {
+        return true;
+    }
+    if (errno != EXDEV) {
+        return false;
+    }
+#endif
+    qCDebug(KLEOPATRA_LOG) << "Cannot rename" << src << "to" << dest << "across file systems. Copying it.";
+    const QString tmpDest = dest + QLatin1String(".part");
+    QFile::remove(tmpDest);
+    if (!copyFile(src, tmpDest)) {
+        return false;
+    }
+    if (!replaceFile(tmpDest, dest)) {
+        QFile::remove(tmpDest);
+        return false;
+    }
+    QFile::remove(src);
+    return true;
+}
@@ -24,5 +24,18 @@ QString stripSuffix(const QString &fileName);
 void recursivelyRemovePath(const QString &path);
 bool recursivelyCopy(const QString &src, const QString &dest);
 bool moveDir(const QString &src, const QString &dest);
+
+/**
+ * Copies the file @p src to @p dest which must not exist. If possible, the
+ * data is shared (reflink) or copied in the kernel instead of being copied
+ * through user space.
+ */
+bool copyFile(const QString &src, const QString &dest);
+
+/**
+ * Atomically replaces @p dest with @p src. Both files should be located on
+ * the same file system; otherwise, the file is copied and @p src is removed.
+ */
+bool replaceFile(const QString &src, const QString &dest);
 }
 
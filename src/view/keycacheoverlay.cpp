@@ -14,6 +14,8 @@
 #include "kleopatra_debug.h"
 #include "waitwidget.h"
 
+#include <utils/keycachesnapshot.h>
+
 #include <QVBoxLayout>
 #include <QEvent>
 #include <KLocalizedString>
@@ -25,8 +27,9 @@ KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
 {
     const auto cache = KeyCache::instance();
 
-    if (cache->initialized()) {
-        // Cache initialized so we are not needed.
+    if (cache->initialized() || KeyCacheSnapshot::instance()->hasInsertedKeys()) {
+        // Cache initialized (or filled with the certificates of the last
+        // session) so we are not needed.
         deleteLater();
         return;
     }
@@ -48,7 +51,7 @@ KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
         // To avoid an infinite show if we miss the keyListingDone signal
         // (Race potential) we use a watchdog timer, too to actively poll
         // the keycache every second. See bug #381910
-        if (KeyCache::instance()->initialized()) {
+        if (KeyCache::instance()->initialized() || KeyCacheSnapshot::instance()->hasInsertedKeys()) {
             qCDebug(KLEOPATRA_LOG) << "Hiding overlay from watchdog";
             hideOverlay();
         }
@@ -57,6 +60,7 @@ KeyCacheOverlay::KeyCacheOverlay(QWidget *baseWidget, QWidget *parent)
     mTimer.start(1000);
 
     connect(cache.get(), &KeyCache::keyListingDone, this, &KeyCacheOverlay::hideOverlay);
+    connect(KeyCacheSnapshot::instance(), &KeyCacheSnapshot::firstKeysInserted, this, &KeyCacheOverlay::hideOverlay);
 }
 
 bool KeyCacheOverlay::eventFilter(QObject *object, QEvent *event)
@@ -74,7 +78,7 @@ void KeyCacheOverlay::reposition()
     if (parentWidget() != mBaseWidget->window()) {
         setParent(mBaseWidget->window());
     }
-    if (!KeyCache::instance()->initialized()) {
+    if (!KeyCache::instance()->initialized() && !KeyCacheSnapshot::instance()->hasInsertedKeys()) {
         show();
     }
 
@@ -93,3 +97,37 @@ void KeyCacheOverlay::hideOverlay()
    mBaseWidget->removeEventFilter(this);
    deleteLater();
 }
+
+KeyCacheLoadingBanner::KeyCacheLoadingBanner(QWidget *parent)
+    : KMessageWidget(parent)
+{
+    const auto cache = KeyCache::instance();
+
+    if (cache->initialized()) {
+        deleteLater();
+        return;
+    }
+
+    setMessageType(KMessageWidget::Information);
+    setText(i18n("Loading certificate cache... The shown certificates may be outdated until loading has finished."));
+    setCloseButtonVisible(false);
+    setWordWrap(true);
+
+    // see KeyCacheOverlay for the reason of the watchdog timer
+    connect(&mTimer, &QTimer::timeout, this, [this]() {
+        if (KeyCache::instance()->initialized()) {
+            qCDebug(KLEOPATRA_LOG) << "Hiding loading banner from watchdog";
+            hideBanner();
+        }
+    });
+    mTimer.start(1000);
+
+    connect(cache.get(), &KeyCache::keyListingDone, this, &KeyCacheLoadingBanner::hideBanner);
+}
+
+void KeyCacheLoadingBanner::hideBanner()
+{
+    mTimer.stop();
+    hide();
+    deleteLater();
+}
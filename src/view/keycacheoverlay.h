@@ -11,6 +11,8 @@
 #include <QWidget>
 #include <QTimer>
 
+#include <KMessageWidget>
+
 namespace Kleo
 {
 
@@ -45,5 +47,26 @@ private:
     QTimer mTimer;
 };
 
+/**
+ * @internal
+ * Banner that is shown while the KeyCache is still loading, i.e. also while
+ * the widgets show the certificates of the last session and are therefore
+ * no longer blocked by the KeyCacheOverlay. It deletes itself when the
+ * key listing is done.
+ */
+class KeyCacheLoadingBanner: public KMessageWidget
+{
+    Q_OBJECT
+public:
+    explicit KeyCacheLoadingBanner(QWidget *parent = nullptr);
+
+private Q_SLOTS:
+    /** Hides the banner and triggers deletion. */
+    void hideBanner();
+
+private:
+    QTimer mTimer;
+};
+
 } // namespace Kleo
 
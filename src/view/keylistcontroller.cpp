@@ -16,6 +16,7 @@
 #include <smartcard/readerstatus.h>
 
 #include <utils/action_data.h>
+#include <utils/keycachesnapshot.h>
 
 #include <settings.h>
 #include "tooltippreferences.h"
@@ -69,9 +70,11 @@
 #include <KLocalizedString>
 
 #include <QAbstractItemView>
+#include <QHash>
 #include <QPointer>
 #include <QItemSelectionModel>
 #include <QAction>
+#include <QTimer>
 
 #include <algorithm>
 #include <iterator>
@@ -132,6 +135,7 @@ public:
     void slotCommandFinished();
     void slotAddKey(const Key &key);
     void slotAboutToRemoveKey(const Key &key);
+    void flushPendingKeys();
     void slotProgress(const QString &what, int current, int total)
     {
         Q_EMIT q->progress(current, total);
@@ -170,6 +174,11 @@ private:
     QPointer<QAbstractItemView> currentView;
     QPointer<AbstractKeyListModel> flatModel, hierarchicalModel;
     std::vector<QMetaObject::Connection> m_connections;
+    // keys added to or removed from the key cache, but not yet to or from the models
+    std::vector<Key> pendingAddedKeys, pendingRemovedKeys;
+    // the position of the keys in pendingAddedKeys by fingerprint
+    QHash<QByteArray, size_t> pendingAddedKeyIndexes;
+    QTimer flushTimer;
 };
 
 KeyListController::Private::Private(KeyListController *qq)
@@ -184,6 +193,12 @@ KeyListController::Private::Private(KeyListController *qq)
 {
     connect(KeyCache::instance().get(), &KeyCache::added, q, [this](const GpgME::Key &key) { slotAddKey(key); });
     connect(KeyCache::instance().get(), &KeyCache::aboutToRemove, q, [this](const GpgME::Key &key) { slotAboutToRemoveKey(key); });
+    // the key cache signals keysMayHaveChanged once after adding or removing
+    // a batch of keys; the timer catches everything else
+    connect(KeyCache::instance().get(), &KeyCache::keysMayHaveChanged, q, [this]() { flushPendingKeys(); });
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(0);
+    connect(&flushTimer, &QTimer::timeout, q, [this]() { flushPendingKeys(); });
 }
 
 KeyListController::Private::~Private() {}
@@ -198,23 +213,62 @@ KeyListController::~KeyListController() {}
 
 void KeyListController::Private::slotAddKey(const Key &key)
 {
-    // ### make model act on keycache directly...
-    if (flatModel) {
-        flatModel->addKey(key);
-    }
-    if (hierarchicalModel) {
-        hierarchicalModel->addKey(key);
+    // collect the keys and add them to the models in one go instead of
+    // updating the models (and all proxies) for every single key
+    const QByteArray fingerprint{key.primaryFingerprint()};
+    const auto it = pendingAddedKeyIndexes.constFind(fingerprint);
+    if (it != pendingAddedKeyIndexes.cend()) {
+        // an update of a pending key replaces the older copy, because the
+        // model would not tell the copies apart
+        pendingAddedKeys[it.value()] = key;
+    } else {
+        pendingAddedKeyIndexes.insert(fingerprint, pendingAddedKeys.size());
+        pendingAddedKeys.push_back(key);
     }
+    flushTimer.start();
 }
 
 void KeyListController::Private::slotAboutToRemoveKey(const Key &key)
 {
-    // ### make model act on keycache directly...
-    if (flatModel) {
-        flatModel->removeKey(key);
+    const auto it = pendingAddedKeyIndexes.find(QByteArray{key.primaryFingerprint()});
+    if (it != pendingAddedKeyIndexes.end()) {
+        // move the last pending key into the gap
+        const size_t index = it.value();
+        pendingAddedKeyIndexes.erase(it);
+        if (index != pendingAddedKeys.size() - 1) {
+            pendingAddedKeys[index] = std::move(pendingAddedKeys.back());
+            pendingAddedKeyIndexes[QByteArray{pendingAddedKeys[index].primaryFingerprint()}] = index;
+        }
+        pendingAddedKeys.pop_back();
     }
-    if (hierarchicalModel) {
-        hierarchicalModel->removeKey(key);
+    pendingRemovedKeys.push_back(key);
+    flushTimer.start();
+}
+
+void KeyListController::Private::flushPendingKeys()
+{
+    flushTimer.stop();
+    if (pendingAddedKeys.empty() && pendingRemovedKeys.empty()) {
+        return;
+    }
+    const std::vector<Key> added = std::move(pendingAddedKeys);
+    const std::vector<Key> removed = std::move(pendingRemovedKeys);
+    pendingAddedKeys.clear();
+    pendingRemovedKeys.clear();
+    pendingAddedKeyIndexes.clear();
+
+    // removals first, so that a key that was removed and added again ends up in the models
+    // ### make model act on keycache directly...
+    for (AbstractKeyListModel *model : {flatModel.data(), hierarchicalModel.data()}) {
+        if (!model) {
+            continue;
+        }
+        for (const Key &key : removed) {
+            model->removeKey(key);
+        }
+        if (!added.empty()) {
+            model->addKeys(added);
+        }
     }
 }
 
@@ -254,7 +308,8 @@ void KeyListController::setFlatModel(AbstractKeyListModel *model)
 
     if (model) {
         model->clear();
-        if (KeyCache::instance()->initialized()) {
+        // the keys of the snapshot are in the key cache before it is initialized
+        if (KeyCache::instance()->initialized() || KeyCacheSnapshot::instance()->hasInsertedKeys()) {
             model->addKeys(KeyCache::instance()->keys());
         }
         model->setToolTipOptions(d->toolTipOptions());
@@ -271,7 +326,8 @@ void KeyListController::setHierarchicalModel(AbstractKeyListModel *model)
 
     if (model) {
         model->clear();
-        if (KeyCache::instance()->initialized()) {
+        // the keys of the snapshot are in the key cache before it is initialized
+        if (KeyCache::instance()->initialized() || KeyCacheSnapshot::instance()->hasInsertedKeys()) {
             model->addKeys(KeyCache::instance()->keys());
         }
         model->setToolTipOptions(d->toolTipOptions());
@@ -0,0 +1,335 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    view/keysearchproxymodel.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#include <config-kleopatra.h>
+
+#include "keysearchproxymodel.h"
+
+#include "kleopatraapplication.h"
+
+#include "utils/keyfiltermembership.h"
+#include "utils/keysearchindex.h"
+#include "utils/keysortcache.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyFilter>
+#include <Libkleo/KeyGroup>
+#include <Libkleo/KeyList>
+#include <Libkleo/KeyListModelInterface>
+
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+
+#include <gpgme++/key.h>
+
+#include <algorithm>
+
+using namespace Kleo;
+
+namespace
+{
+/**
+ * The display data of the certificates (texts, tool tips, colors, fonts and
+ * icons) per source model, so that repainting a view does not format the
+ * same certificates again. The data of a certificate is dropped when the
+ * model reports it as changed; all data is dropped when the configuration
+ * (e.g. the tool tip options or the appearance of the key filters) changes.
+ */
+class DisplayDataCache : public QObject
+{
+public:
+    static DisplayDataCache *instance()
+    {
+        static DisplayDataCache cache;
+        return &cache;
+    }
+
+    static bool isCached(int role)
+    {
+        switch (role) {
+        case Qt::DisplayRole:
+        case Qt::ToolTipRole:
+        case Qt::DecorationRole:
+        case Qt::FontRole:
+        case Qt::ForegroundRole:
+        case Qt::BackgroundRole:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template<typename Compute>
+    QVariant data(const QAbstractItemModel *model, const GpgME::Key &key, int column, int role, Compute compute)
+    {
+        QHash<quint32, QVariant> &keyData = cacheFor(model)[QByteArray{key.primaryFingerprint()}];
+        const quint32 id = (quint32(column) << 16) | quint32(role);
+        auto it = keyData.constFind(id);
+        if (it == keyData.cend()) {
+            it = keyData.insert(id, compute());
+        }
+        return *it;
+    }
+
+private:
+    DisplayDataCache()
+    {
+        connect(KeyCache::instance().get(), &KeyCache::aboutToRemove, this, [this](const GpgME::Key &key) {
+            for (auto &modelData : m_data) {
+                modelData.remove(QByteArray{key.primaryFingerprint()});
+            }
+        });
+        connect(KleopatraApplication::instance(), &KleopatraApplication::configurationChanged, this, [this]() {
+            for (auto &modelData : m_data) {
+                modelData.clear();
+            }
+        });
+    }
+
+    QHash<QByteArray, QHash<quint32, QVariant>> &cacheFor(const QAbstractItemModel *model)
+    {
+        if (!m_connectedModels.contains(model)) {
+            m_connectedModels.insert(model);
+            connect(model, &QAbstractItemModel::dataChanged, this, [this, model](const QModelIndex &topLeft, const QModelIndex &bottomRight) {
+                forgetRows(model, topLeft, bottomRight);
+            });
+            connect(model, &QAbstractItemModel::modelReset, this, [this, model]() {
+                m_data[model].clear();
+            });
+            connect(model, &QObject::destroyed, this, [this, model]() {
+                m_data.remove(model);
+                m_connectedModels.remove(model);
+            });
+        }
+        return m_data[model];
+    }
+
+    void forgetRows(const QAbstractItemModel *model, const QModelIndex &topLeft, const QModelIndex &bottomRight)
+    {
+        const auto klm = dynamic_cast<const KeyListModelInterface *>(model);
+        if (!klm || !topLeft.isValid()) {
+            m_data[model].clear();
+            return;
+        }
+        auto &modelData = m_data[model];
+        for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+            const GpgME::Key key = klm->key(model->index(row, 0, topLeft.parent()));
+            if (!key.isNull()) {
+                modelData.remove(QByteArray{key.primaryFingerprint()});
+            }
+        }
+    }
+
+private:
+    QSet<const QAbstractItemModel *> m_connectedModels;
+    QHash<const QAbstractItemModel *, QHash<QByteArray, QHash<quint32, QVariant>>> m_data;
+};
+}
+
+class KeySearchProxyModel::Private
+{
+public:
+    bool acceptsKey(const GpgME::Key &key) const;
+
+    // the source model as KeyListModelInterface, so that lessThan() doesn't
+    // need a dynamic_cast for every comparison
+    QPointer<QAbstractItemModel> keyListSourceModel;
+    KeyListModelInterface *keyListModel = nullptr;
+
+    QString searchString;
+    std::shared_ptr<const KeySearchIndex::Result> result;
+
+    std::shared_ptr<const KeyFilter> keyFilter;
+    // the filter that is used for filtering; the previous filter is kept
+    // until the new one has been evaluated for all certificates
+    std::shared_ptr<const KeyFilter> appliedKeyFilter;
+};
+
+bool KeySearchProxyModel::Private::acceptsKey(const GpgME::Key &key) const
+{
+    return !appliedKeyFilter || KeyFilterMembership::instance()->matches(appliedKeyFilter, key);
+}
+
+KeySearchProxyModel::KeySearchProxyModel(QObject *parent)
+    : KeyListSortFilterProxyModel(parent)
+    , d(new Private)
+{
+    connect(KeySearchIndex::instance(), &KeySearchIndex::changed, this, [this]() {
+        if (!d->searchString.isEmpty()) {
+            updateSearchResult();
+        }
+    });
+    connect(KeyFilterMembership::instance(), &KeyFilterMembership::ready, this, &KeySearchProxyModel::applyKeyFilter);
+}
+
+KeySearchProxyModel::KeySearchProxyModel(const KeySearchProxyModel &other)
+    : KeyListSortFilterProxyModel(other)
+    , d(new Private)
+{
+    d->searchString = other.d->searchString;
+    d->result = other.d->result;
+    d->keyFilter = other.d->keyFilter;
+    d->appliedKeyFilter = other.d->appliedKeyFilter;
+    d->keyListSourceModel = sourceModel();
+    d->keyListModel = dynamic_cast<KeyListModelInterface *>(sourceModel());
+    KeyFilterMembership::instance()->prepare(d->keyFilter);
+    connect(KeySearchIndex::instance(), &KeySearchIndex::changed, this, [this]() {
+        if (!d->searchString.isEmpty()) {
+            updateSearchResult();
+        }
+    });
+    connect(KeyFilterMembership::instance(), &KeyFilterMembership::ready, this, &KeySearchProxyModel::applyKeyFilter);
+}
+
+KeySearchProxyModel::~KeySearchProxyModel()
+{
+    KeyFilterMembership::instance()->release(d->keyFilter);
+}
+
+KeySearchProxyModel *KeySearchProxyModel::clone() const
+{
+    return new KeySearchProxyModel(*this);
+}
+
+void KeySearchProxyModel::setSearchString(const QString &text)
+{
+    if (text == d->searchString) {
+        return;
+    }
+    d->searchString = text;
+    updateSearchResult();
+}
+
+QString KeySearchProxyModel::searchString() const
+{
+    return d->searchString;
+}
+
+void KeySearchProxyModel::updateSearchResult()
+{
+    if (d->searchString.isEmpty()) {
+        d->result.reset();
+    } else {
+        d->result = KeySearchIndex::instance()->search(d->searchString);
+    }
+    invalidateFilter();
+}
+
+void KeySearchProxyModel::setKeyFilter(const std::shared_ptr<const KeyFilter> &filter)
+{
+    if (filter == d->keyFilter) {
+        return;
+    }
+    auto membership = KeyFilterMembership::instance();
+    // cancels the evaluation of the previous filter if nobody else needs it
+    membership->release(d->keyFilter);
+    d->keyFilter = filter;
+    membership->prepare(filter);
+    if (!filter || !d->appliedKeyFilter || membership->isReady(filter)) {
+        // if no filter has been applied yet, then there is no previous
+        // result to keep, so the filter is evaluated directly until it is ready
+        applyKeyFilter(filter.get());
+    }
+}
+
+std::shared_ptr<const KeyFilter> KeySearchProxyModel::keyFilter() const
+{
+    return d->keyFilter;
+}
+
+void KeySearchProxyModel::applyKeyFilter(const KeyFilter *filter)
+{
+    if (filter != d->keyFilter.get() || d->appliedKeyFilter == d->keyFilter) {
+        return;
+    }
+    d->appliedKeyFilter = d->keyFilter;
+    invalidateFilter();
+}
+
+bool KeySearchProxyModel::hasAcceptedChildren(const QModelIndex &source_index) const
+{
+    // the parents of accepted children are kept, e.g. the issuers of the
+    // matching certificates in the hierarchical view
+    const int rows = sourceModel()->rowCount(source_index);
+    for (int row = 0; row < rows; ++row) {
+        if (filterAcceptsRow(row, source_index)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool KeySearchProxyModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
+{
+    const auto klm = dynamic_cast<KeyListModelInterface *>(sourceModel());
+    if (!klm) {
+        return KeyListSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+    }
+    const QModelIndex index = sourceModel()->index(source_row, KeyList::PrettyName, source_parent);
+    const GpgME::Key key = klm->key(index);
+    if (!key.isNull()) {
+        if (d->result && !d->result->contains(key)) {
+            return hasAcceptedChildren(index.siblingAtColumn(0));
+        }
+        if (!d->acceptsKey(key)) {
+            return hasAcceptedChildren(index.siblingAtColumn(0));
+        }
+    } else {
+        const KeyGroup group = klm->group(index);
+        if (!group.isNull()) {
+            if (d->result && !KeySearchIndex::matches(group.name(), d->searchString)) {
+                return false;
+            }
+            const KeyGroup::Keys &keys = group.keys();
+            if (!std::all_of(keys.cbegin(), keys.cend(), [this](const GpgME::Key &key) {
+                    return d->acceptsKey(key);
+                })) {
+                return false;
+            }
+        }
+    }
+    return KeyListSortFilterProxyModel::filterAcceptsRow(source_row, source_parent);
+}
+
+void KeySearchProxyModel::setSourceModel(QAbstractItemModel *model)
+{
+    KeyListSortFilterProxyModel::setSourceModel(model);
+    d->keyListSourceModel = model;
+    d->keyListModel = dynamic_cast<KeyListModelInterface *>(model);
+}
+
+bool KeySearchProxyModel::lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const
+{
+    // the cached texts give the same order as the base class, but only
+    // with the sort settings of the key list views
+    if (KeySortCache::isCached(source_left.column()) && d->keyListSourceModel && d->keyListModel
+        && sortRole() == Qt::DisplayRole && sortCaseSensitivity() == Qt::CaseInsensitive && !isSortLocaleAware()) {
+        if (const auto result = KeySortCache::instance()->compare(d->keyListModel, source_left, source_right)) {
+            return *result < 0;
+        }
+    }
+    return KeyListSortFilterProxyModel::lessThan(source_left, source_right);
+}
+
+QVariant KeySearchProxyModel::data(const QModelIndex &index, int role) const
+{
+    if (DisplayDataCache::isCached(role) && index.isValid()) {
+        if (const auto klm = dynamic_cast<KeyListModelInterface *>(sourceModel())) {
+            const QModelIndex sourceIndex = mapToSource(index);
+            const GpgME::Key key = klm->key(sourceIndex);
+            if (!key.isNull()) {
+                return DisplayDataCache::instance()->data(sourceModel(), key, sourceIndex.column(), role, [this, &index, role]() {
+                    return KeyListSortFilterProxyModel::data(index, role);
+                });
+            }
+        }
+    }
+    return KeyListSortFilterProxyModel::data(index, role);
+}
@@ -0,0 +1,70 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    view/keysearchproxymodel.h
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+#pragma once
+
+#include <Libkleo/KeyListSortFilterProxyModel>
+
+#include <memory>
+
+namespace Kleo
+{
+
+/**
+ * A KeyListSortFilterProxyModel that answers the string filter from the
+ * KeySearchIndex instead of matching a regular expression against the
+ * data of every certificate.
+ *
+ * The results of the key filter are taken from KeyFilterMembership, which
+ * evaluates each filter once per certificate for all views. Until a new
+ * key filter has been evaluated for all certificates, the view keeps
+ * showing the result of the previous key filter; then the new filter is
+ * applied at once.
+ *
+ * Names and email addresses are sorted by the case-folded texts of the
+ * KeySortCache, which are computed once per certificate and shared by all
+ * views. The display data of the certificates is cached per source model,
+ * too.
+ */
+class KeySearchProxyModel : public KeyListSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit KeySearchProxyModel(QObject *parent = nullptr);
+    ~KeySearchProxyModel() override;
+
+    void setSearchString(const QString &text);
+    QString searchString() const;
+
+    // hides KeyListSortFilterProxyModel::setKeyFilter() and keyFilter()
+    void setKeyFilter(const std::shared_ptr<const KeyFilter> &filter);
+    std::shared_ptr<const KeyFilter> keyFilter() const;
+
+    KeySearchProxyModel *clone() const override;
+
+    void setSourceModel(QAbstractItemModel *model) override;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+protected:
+    bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+    bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override;
+
+private:
+    KeySearchProxyModel(const KeySearchProxyModel &other);
+    void updateSearchResult();
+    bool hasAcceptedChildren(const QModelIndex &source_index) const;
+    void applyKeyFilter(const KeyFilter *filter);
+
+private:
+    class Private;
+    const std::unique_ptr<Private> d;
+};
+
+}
@@ -10,6 +10,7 @@
 #include <config-kleopatra.h>
 
 #include "keytreeview.h"
+#include "keysearchproxymodel.h"
 #include "searchbar.h"
 
 #include <Libkleo/KeyList>
@@ -151,7 +152,7 @@ const KeyListModelInterface * keyListModel(const QTreeView &view)
 
 KeyTreeView::KeyTreeView(QWidget *parent)
     : QWidget(parent),
-      m_proxy(new KeyListSortFilterProxyModel(this)),
+      m_proxy(new KeySearchProxyModel(this)),
       m_additionalProxy(nullptr),
       m_view(new TreeView(this)),
       m_flatModel(nullptr),
@@ -165,7 +166,7 @@ KeyTreeView::KeyTreeView(QWidget *parent)
 
 KeyTreeView::KeyTreeView(const KeyTreeView &other)
     : QWidget(nullptr),
-      m_proxy(new KeyListSortFilterProxyModel(this)),
+      m_proxy(new KeySearchProxyModel(this)),
       m_additionalProxy(other.m_additionalProxy ? other.m_additionalProxy->clone() : nullptr),
       m_view(new TreeView(this)),
       m_flatModel(other.m_flatModel),
@@ -184,7 +185,7 @@ KeyTreeView::KeyTreeView(const QString &text, const std::shared_ptr<KeyFilter> &
                          AbstractKeyListSortFilterProxyModel *proxy, QWidget *parent,
                          const KConfigGroup &group)
     : QWidget(parent),
-      m_proxy(new KeyListSortFilterProxyModel(this)),
+      m_proxy(new KeySearchProxyModel(this)),
       m_additionalProxy(proxy),
       m_view(new TreeView(this)),
       m_flatModel(nullptr),
@@ -291,7 +292,7 @@ void KeyTreeView::init()
         }
     }
 
-    m_proxy->setFilterRegularExpression(QRegularExpression::escape(m_stringFilter));
+    m_proxy->setSearchString(m_stringFilter);
     m_proxy->setKeyFilter(m_keyFilter);
     m_proxy->setSortCaseSensitivity(Qt::CaseInsensitive);
 
@@ -317,9 +318,15 @@ void KeyTreeView::init()
 
     /* Handle expansion state */
     if (m_group.isValid()) {
-        m_expandedKeys = m_group.readEntry("Expanded", QStringList());
+        const QStringList expandedKeys = m_group.readEntry("Expanded", QStringList());
+        m_expandedKeys = QSet<QString>{expandedKeys.cbegin(), expandedKeys.cend()};
     }
 
+    m_saveExpandStateTimer = new QTimer(this);
+    m_saveExpandStateTimer->setSingleShot(true);
+    m_saveExpandStateTimer->setInterval(1000);
+    connect(m_saveExpandStateTimer, &QTimer::timeout, this, &KeyTreeView::saveExpandState);
+
     connect(m_view, &QTreeView::expanded, this, [this] (const QModelIndex &index) {
         if (!index.isValid()) {
             return;
@@ -333,10 +340,8 @@ void KeyTreeView::init()
         if (m_expandedKeys.contains(fpr)) {
             return;
         }
-        m_expandedKeys << fpr;
-        if (m_group.isValid()) {
-            m_group.writeEntry("Expanded", m_expandedKeys);
-        }
+        m_expandedKeys.insert(fpr);
+        m_saveExpandStateTimer->start();
     });
 
     connect(m_view, &QTreeView::collapsed, this, [this] (const QModelIndex &index) {
@@ -347,25 +352,36 @@ void KeyTreeView::init()
         if (key.isNull()) {
             return;
         }
-        m_expandedKeys.removeAll(QString::fromLatin1(key.primaryFingerprint()));
-        if (m_group.isValid()) {
-            m_group.writeEntry("Expanded", m_expandedKeys);
+        if (m_expandedKeys.remove(QString::fromLatin1(key.primaryFingerprint()))) {
+            m_saveExpandStateTimer->start();
         }
     });
 
-    connect(KeyCache::instance().get(), &KeyCache::keysMayHaveChanged, this, [this] () {
-        /* We use a single shot timer here to ensure that the keysMayHaveChanged
-         * handlers are all handled before we restore the expand state so that
-         * the model is already populated. */
-        QTimer::singleShot(0, [this] () {
-            restoreExpandState();
-            setUpTagKeys();
-            if (!m_onceResized) {
-                m_onceResized = true;
-                resizeColumns();
-            }
-        });
+    /* We use a single shot timer here to ensure that the keysMayHaveChanged
+     * handlers are all handled before we restore the expand state so that
+     * the model is already populated. */
+    m_keysChangedTimer = new QTimer(this);
+    m_keysChangedTimer->setSingleShot(true);
+    m_keysChangedTimer->setInterval(0);
+    connect(m_keysChangedTimer, &QTimer::timeout, this, [this] () {
+        restoreExpandState();
+        setUpTagKeys();
+        if (!m_onceResized) {
+            m_onceResized = true;
+            resizeColumns();
+        }
     });
+    connect(KeyCache::instance().get(), &KeyCache::keysMayHaveChanged,
+            m_keysChangedTimer, qOverload<>(&QTimer::start));
+
+    // rows that were hidden by the search or the key filter are shown
+    // collapsed again
+    m_restoreExpandStateTimer = new QTimer(this);
+    m_restoreExpandStateTimer->setSingleShot(true);
+    m_restoreExpandStateTimer->setInterval(0);
+    connect(m_restoreExpandStateTimer, &QTimer::timeout, this, &KeyTreeView::restoreExpandState);
+    connect(m_proxy, &QAbstractItemModel::rowsInserted,
+            m_restoreExpandStateTimer, qOverload<>(&QTimer::start));
     resizeColumns();
     if (m_group.isValid()) {
         restoreLayout(m_group);
@@ -378,25 +394,70 @@ void KeyTreeView::restoreExpandState()
         qCWarning(KLEOPATRA_LOG) << "Restore expand state before keycache available. Aborting.";
         return;
     }
-    for (const auto &fpr: std::as_const(m_expandedKeys)) {
-        const KeyListModelInterface *const km = keyListModel(*m_view);
-        if (!km) {
-            qCWarning(KLEOPATRA_LOG) << "invalid model";
-            return;
-        }
+    if (m_expandedKeys.isEmpty()) {
+        return;
+    }
+    const KeyListModelInterface *const km = keyListModel(*m_view);
+    if (!km) {
+        qCWarning(KLEOPATRA_LOG) << "invalid model";
+        return;
+    }
+
+    std::vector<Key> keys;
+    keys.reserve(m_expandedKeys.size());
+    QSet<QString> staleKeys;
+    for (const auto &fpr : std::as_const(m_expandedKeys)) {
         const auto key = KeyCache::instance()->findByFingerprint(fpr.toLatin1().constData());
         if (key.isNull()) {
             qCDebug(KLEOPATRA_LOG) << "Cannot find:" << fpr << "anymore in cache";
-            m_expandedKeys.removeAll(fpr);
-            return;
+            staleKeys.insert(fpr);
+        } else {
+            keys.push_back(key);
         }
-        const auto idx = km->index(key);
-        if (!idx.isValid()) {
-            qCDebug(KLEOPATRA_LOG) << "Cannot find:" << fpr << "anymore in model";
-            m_expandedKeys.removeAll(fpr);
-            return;
+    }
+
+    // look up all indexes at once and expand them without repainting in between
+    QSet<QString> foundKeys;
+    const bool updatesEnabled = m_view->updatesEnabled();
+    m_view->setUpdatesEnabled(false);
+    for (const QModelIndex &idx : km->indexes(keys)) {
+        if (idx.isValid()) {
+            foundKeys.insert(QString::fromLatin1(km->key(idx).primaryFingerprint()));
+            m_view->expand(idx);
+        }
+    }
+    m_view->setUpdatesEnabled(updatesEnabled);
+
+    // keys hidden by the search or the key filter are expanded again when
+    // they are shown again, so only keys missing in the unfiltered model
+    // are forgotten
+    std::vector<Key> hiddenKeys;
+    for (const Key &key : keys) {
+        if (!foundKeys.contains(QString::fromLatin1(key.primaryFingerprint()))) {
+            hiddenKeys.push_back(key);
+        }
+    }
+    if (!hiddenKeys.empty() && model()) {
+        const QModelIndexList sourceIndexes = model()->indexes(hiddenKeys);
+        for (int i = 0; i < sourceIndexes.size(); ++i) {
+            if (!sourceIndexes[i].isValid()) {
+                const auto fpr = QString::fromLatin1(hiddenKeys[i].primaryFingerprint());
+                qCDebug(KLEOPATRA_LOG) << "Cannot find:" << fpr << "anymore in model";
+                staleKeys.insert(fpr);
+            }
         }
-        m_view->expand(idx);
+    }
+    if (!staleKeys.isEmpty()) {
+        m_expandedKeys.subtract(staleKeys);
+        m_saveExpandStateTimer->start();
+    }
+}
+
+void KeyTreeView::saveExpandState()
+{
+    m_saveExpandStateTimer->stop();
+    if (m_group.isValid()) {
+        m_group.writeEntry("Expanded", QStringList{m_expandedKeys.cbegin(), m_expandedKeys.cend()});
     }
 }
 
@@ -493,6 +554,9 @@ void KeyTreeView::restoreLayout(const KConfigGroup &group)
 
 KeyTreeView::~KeyTreeView()
 {
+    if (m_saveExpandStateTimer->isActive()) {
+        saveExpandState();
+    }
     if (m_group.isValid()) {
         saveLayout(m_group);
     }
@@ -541,7 +605,7 @@ void KeyTreeView::setStringFilter(const QString &filter)
         return;
     }
     m_stringFilter = filter;
-    m_proxy->setFilterRegularExpression(QRegularExpression::escape(filter));
+    m_proxy->setSearchString(filter);
     Q_EMIT stringFilterChanged(filter);
 }
 
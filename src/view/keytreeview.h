@@ -11,6 +11,7 @@
 
 #include <QWidget>
 
+#include <QSet>
 #include <QString>
 #include <QStringList>
 
@@ -21,6 +22,7 @@
 
 #include <KConfigGroup>
 
+class QTimer;
 class QTreeView;
 
 namespace Kleo
@@ -29,7 +31,7 @@ namespace Kleo
 class KeyFilter;
 class AbstractKeyListModel;
 class AbstractKeyListSortFilterProxyModel;
-class KeyListSortFilterProxyModel;
+class KeySearchProxyModel;
 class SearchBar;
 
 class KeyTreeView : public QWidget
@@ -131,12 +133,13 @@ private:
     void init();
     void addKeysImpl(const std::vector<GpgME::Key> &, bool);
     void restoreExpandState();
+    void saveExpandState();
     void setUpTagKeys();
 
 private:
     std::vector<GpgME::Key> m_keys;
 
-    KeyListSortFilterProxyModel *m_proxy;
+    KeySearchProxyModel *m_proxy;
     AbstractKeyListSortFilterProxyModel *m_additionalProxy;
 
     QTreeView *m_view;
@@ -147,7 +150,12 @@ private:
     QString m_stringFilter;
     std::shared_ptr<KeyFilter> m_keyFilter;
 
-    QStringList m_expandedKeys;
+    QSet<QString> m_expandedKeys;
+    // writes the expand state to the configuration after a short delay
+    QTimer *m_saveExpandStateTimer = nullptr;
+    // coalesces the handling of several keysMayHaveChanged signals
+    QTimer *m_keysChangedTimer = nullptr;
+    QTimer *m_restoreExpandStateTimer = nullptr;
 
     std::vector<QMetaObject::Connection> m_connections;
 
@@ -105,7 +105,9 @@ NetKeyWidget::NetKeyWidget(QWidget *parent) :
 
         connect(cmd, &Command::finished, this, [icon] () {
             ReaderStatus::mutableInstance()->updateStatus();
-            icon->setLearningInProgress(false);
+            if (icon) {
+                icon->setLearningInProgress(false);
+            }
         });
     });
 
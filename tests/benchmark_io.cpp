@@ -0,0 +1,292 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    tests/benchmark_io.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+//
+// Usage: benchmark_io [--dir <directory>] [--sizes <MiB,...>] [--buffers <KiB,...>] [--repeat <n>]
+//
+// Measures the throughput of Kleopatra's Input/Output classes and prints one
+// line of comma-separated values per measurement:
+//   scenario,file size (bytes),buffer size (bytes),seconds,MB/s,CPU seconds per GB
+//
+
+#include <config-kleopatra.h>
+
+#include "utils/input.h"
+#include "utils/output.h"
+
+#include <Libkleo/KleoException>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QIODevice>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+#ifndef Q_OS_WIN
+# include <unistd.h>
+#endif
+
+#include <ctime>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace Kleo;
+
+namespace
+{
+
+struct Measurement {
+    double seconds;
+    double cpuSeconds;
+};
+
+Measurement measure(const std::function<void()> &f)
+{
+    QElapsedTimer timer;
+    const std::clock_t cpuStart = std::clock();
+    timer.start();
+    f();
+    const qint64 nsecs = timer.nsecsElapsed();
+    const std::clock_t cpuEnd = std::clock();
+    return {nsecs / 1e9, double(cpuEnd - cpuStart) / CLOCKS_PER_SEC};
+}
+
+void report(const char *scenario, qint64 size, qint64 bufferSize, const Measurement &m)
+{
+    const double mb = size / 1e6;
+    const double gb = size / 1e9;
+    std::cout << scenario << ',' << size << ',' << bufferSize << ',' << m.seconds << ','
+              << (m.seconds > 0 ? mb / m.seconds : 0.0) << ','
+              << (gb > 0 ? m.cpuSeconds / gb : 0.0) << std::endl;
+}
+
+void writeAll(QIODevice *dev, const QByteArray &chunk, qint64 size)
+{
+    qint64 remaining = size;
+    while (remaining > 0) {
+        const qint64 n = dev->write(chunk.constData(), qMin<qint64>(chunk.size(), remaining));
+        if (n < 0) {
+            throw Exception(gpg_error(GPG_ERR_EIO), dev->errorString());
+        }
+        remaining -= n;
+    }
+}
+
+qint64 readAll(QIODevice *dev, qint64 bufferSize)
+{
+    std::vector<char> buffer(bufferSize);
+    qint64 total = 0;
+    while (true) {
+        const qint64 n = dev->read(buffer.data(), bufferSize);
+        if (n > 0) {
+            total += n;
+            continue;
+        }
+        if (n < 0 || !dev->isSequential() || !dev->waitForReadyRead(-1)) {
+            break;
+        }
+    }
+    return total;
+}
+
+QByteArray randomChunk(qint64 size)
+{
+    QByteArray chunk(size, Qt::Uninitialized);
+    QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(chunk.data()), size / sizeof(quint32));
+    return chunk;
+}
+
+void createSourceFile(const QString &fileName, qint64 size)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        throw Exception(gpg_error(GPG_ERR_EIO), file.errorString());
+    }
+    writeAll(&file, randomChunk(1024 * 1024), size);
+}
+
+void benchmarkFileToFile(const QString &dir, const QString &source, qint64 size, qint64 bufferSize)
+{
+    const QString target = dir + QStringLiteral("/file-out");
+    QFile::remove(target);
+    const Measurement m = measure([&]() {
+        const auto input = Input::createFromFile(source);
+        const auto output = Output::createFromFile(target, true);
+        output->reserve(input->size());
+        std::vector<char> buffer(bufferSize);
+        qint64 n;
+        while ((n = input->ioDevice()->read(buffer.data(), bufferSize)) > 0) {
+            writeAll(output->ioDevice().get(), QByteArray::fromRawData(buffer.data(), n), n);
+        }
+        input->finalize();
+        output->finalize();
+    });
+    report("file-to-file", size, bufferSize, m);
+}
+
+void benchmarkOutputInput(const QString &dir, qint64 size, qint64 bufferSize)
+{
+    const QString target = dir + QStringLiteral("/chained");
+    QFile::remove(target);
+    const QByteArray chunk = randomChunk(bufferSize);
+    const Measurement m = measure([&]() {
+        const auto output = Output::createFromFile(target, true);
+        const auto input = Input::createFromOutput(output);
+        writeAll(output->ioDevice().get(), chunk, size);
+        output->finalize();
+        if (readAll(input->ioDevice().get(), bufferSize) != size) {
+            throw Exception(gpg_error(GPG_ERR_EIO), QStringLiteral("Short read from chained output"));
+        }
+        input->finalize();
+    });
+    report("output-input-chain", size, bufferSize, m);
+}
+
+void benchmarkByteArray(qint64 size, qint64 bufferSize)
+{
+    const QByteArray chunk = randomChunk(bufferSize);
+    const Measurement m = measure([&]() {
+        QByteArray data;
+        const auto output = Output::createFromByteArray(&data, QStringLiteral("benchmark"));
+        writeAll(output->ioDevice().get(), chunk, size);
+        output->finalize();
+        const auto input = Input::createFromByteArray(&data, QStringLiteral("benchmark"));
+        if (readAll(input->ioDevice().get(), bufferSize) != size) {
+            throw Exception(gpg_error(GPG_ERR_EIO), QStringLiteral("Short read from byte array"));
+        }
+    });
+    report("byte-array", size, bufferSize, m);
+}
+
+void benchmarkProcessStdOut(const QString &source, qint64 size, qint64 bufferSize)
+{
+    const Measurement m = measure([&]() {
+        const auto input = Input::createFromProcessStdOut(QStringLiteral("cat"), {source});
+        if (readAll(input->ioDevice().get(), bufferSize) != size) {
+            throw Exception(gpg_error(GPG_ERR_EIO), QStringLiteral("Short read from process"));
+        }
+        input->finalize();
+    });
+    report("process-stdout", size, bufferSize, m);
+}
+
+#ifndef Q_OS_WIN
+void benchmarkPipeInput(qint64 size, qint64 bufferSize)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw Exception(gpg_error_from_syserror(), QStringLiteral("pipe() failed"));
+    }
+    const QByteArray chunk = randomChunk(bufferSize);
+    const Measurement m = measure([&]() {
+        const auto input = Input::createFromPipeDevice(fds[0], QStringLiteral("benchmark"));
+        std::thread writer([&]() {
+            qint64 remaining = size;
+            while (remaining > 0) {
+                const ssize_t n = ::write(fds[1], chunk.constData(), qMin<qint64>(chunk.size(), remaining));
+                if (n <= 0) {
+                    break;
+                }
+                remaining -= n;
+            }
+            ::close(fds[1]);
+        });
+        readAll(input->ioDevice().get(), bufferSize);
+        writer.join();
+        input->finalize();
+    });
+    report("pipe-input", size, bufferSize, m);
+}
+
+void benchmarkPipeOutput(qint64 size, qint64 bufferSize)
+{
+    int fds[2];
+    if (pipe(fds) != 0) {
+        throw Exception(gpg_error_from_syserror(), QStringLiteral("pipe() failed"));
+    }
+    const QByteArray chunk = randomChunk(bufferSize);
+    const Measurement m = measure([&]() {
+        const auto output = Output::createFromPipeDevice(fds[1], QStringLiteral("benchmark"));
+        std::thread reader([&]() {
+            std::vector<char> buffer(bufferSize);
+            while (::read(fds[0], buffer.data(), buffer.size()) > 0) {
+            }
+            ::close(fds[0]);
+        });
+        writeAll(output->ioDevice().get(), chunk, size);
+        output->finalize();
+        reader.join();
+    });
+    report("pipe-output", size, bufferSize, m);
+}
+#endif
+
+QList<qint64> parseList(const QString &value, qint64 unit)
+{
+    QList<qint64> result;
+    const auto parts = value.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        result.push_back(part.toLongLong() * unit);
+    }
+    return result;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("dir"), QStringLiteral("Directory for the test files."), QStringLiteral("directory")});
+    parser.addOption({QStringLiteral("sizes"), QStringLiteral("Comma-separated list of data sizes in MiB."), QStringLiteral("sizes"), QStringLiteral("1,64,512")});
+    parser.addOption({QStringLiteral("buffers"), QStringLiteral("Comma-separated list of buffer sizes in KiB."), QStringLiteral("buffers"), QStringLiteral("4,64,1024")});
+    parser.addOption({QStringLiteral("repeat"), QStringLiteral("Number of runs of each measurement."), QStringLiteral("n"), QStringLiteral("3")});
+    parser.process(app);
+
+    const QTemporaryDir tmpDir(parser.isSet(QStringLiteral("dir")) ? parser.value(QStringLiteral("dir")) + QStringLiteral("/benchmark_io-XXXXXX") : QString());
+    if (!tmpDir.isValid()) {
+        std::cerr << "Could not create temporary directory" << std::endl;
+        return 1;
+    }
+    const QString dir = tmpDir.path();
+    const auto sizes = parseList(parser.value(QStringLiteral("sizes")), 1024 * 1024);
+    const auto bufferSizes = parseList(parser.value(QStringLiteral("buffers")), 1024);
+    const int repeat = qMax(parser.value(QStringLiteral("repeat")).toInt(), 1);
+
+    std::cout << "scenario,size,buffer,seconds,mb_per_s,cpu_s_per_gb" << std::endl;
+    try {
+        for (const qint64 size : sizes) {
+            const QString source = dir + QStringLiteral("/source");
+            createSourceFile(source, size);
+            for (const qint64 bufferSize : bufferSizes) {
+                for (int i = 0; i < repeat; ++i) {
+                    benchmarkFileToFile(dir, source, size, bufferSize);
+                    benchmarkOutputInput(dir, size, bufferSize);
+                    benchmarkByteArray(size, bufferSize);
+                    benchmarkProcessStdOut(source, size, bufferSize);
+#ifndef Q_OS_WIN
+                    benchmarkPipeInput(size, bufferSize);
+                    benchmarkPipeOutput(size, bufferSize);
+#endif
+                }
+            }
+            QFile::remove(source);
+        }
+    } catch (const Exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
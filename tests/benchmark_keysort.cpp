@@ -0,0 +1,105 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    tests/benchmark_keysort.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+//
+// Usage: benchmark_keysort [--repeat <n>]
+//
+// Measures sorting the certificates of the keyring in $GNUPGHOME by name and
+// by email address, once with the comparison of KeyListSortFilterProxyModel
+// and once with the cached texts of KeySortCache, and prints one line of
+// comma-separated values per sort:
+//   comparison,column,certificates,run,milliseconds
+//
+// The first run with the cache includes filling the cache.
+//
+
+#include <config-kleopatra.h>
+
+#include "utils/keysortcache.h"
+
+#include <Libkleo/KeyCache>
+#include <Libkleo/KeyList>
+#include <Libkleo/KeyListModel>
+#include <Libkleo/KeyListSortFilterProxyModel>
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+
+#include <iostream>
+#include <memory>
+
+using namespace Kleo;
+
+namespace
+{
+
+// compares like KeySearchProxyModel::lessThan()
+class CachedSortProxyModel : public KeyListSortFilterProxyModel
+{
+protected:
+    bool lessThan(const QModelIndex &source_left, const QModelIndex &source_right) const override
+    {
+        if (KeySortCache::isCached(source_left.column())) {
+            if (const auto klm = dynamic_cast<KeyListModelInterface *>(sourceModel())) {
+                if (const auto result = KeySortCache::instance()->compare(klm, source_left, source_right)) {
+                    return *result < 0;
+                }
+            }
+        }
+        return KeyListSortFilterProxyModel::lessThan(source_left, source_right);
+    }
+};
+
+void measure(const char *comparison, KeyListSortFilterProxyModel *proxy, AbstractKeyListModel *model, int repeat)
+{
+    proxy->setSortCaseSensitivity(Qt::CaseInsensitive);
+    proxy->setSourceModel(model);
+    for (const int column : {KeyList::PrettyName, KeyList::PrettyEMail}) {
+        for (int run = 0; run < repeat; ++run) {
+            QElapsedTimer timer;
+            timer.start();
+            // alternate the order, so that every run sorts again
+            proxy->sort(column, (run % 2) ? Qt::DescendingOrder : Qt::AscendingOrder);
+            const qint64 nsecs = timer.nsecsElapsed();
+            std::cout << comparison << ',' << (column == KeyList::PrettyName ? "name" : "email") << ',' << model->rowCount() << ',' << run << ','
+                      << nsecs / 1e6 << std::endl;
+        }
+    }
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("repeat"), QStringLiteral("Number of sorts per column."), QStringLiteral("n"), QStringLiteral("5")});
+    parser.process(app);
+
+    const int repeat = qMax(parser.value(QStringLiteral("repeat")).toInt(), 1);
+
+    // KeyCache::keys() waits for the key listing
+    const std::unique_ptr<AbstractKeyListModel> model{AbstractKeyListModel::createFlatKeyListModel()};
+    model->addKeys(KeyCache::instance()->keys());
+
+    std::cout << "comparison,column,certificates,run,milliseconds" << std::endl;
+    {
+        KeyListSortFilterProxyModel proxy;
+        measure("base", &proxy, model.get(), repeat);
+    }
+    {
+        CachedSortProxyModel proxy;
+        measure("cached", &proxy, model.get(), repeat);
+    }
+
+    return 0;
+}
@@ -0,0 +1,411 @@
+/* -*- mode: c++; c-basic-offset:4 -*-
+    tests/loadtest_uiserver.cpp
+
+    This file is part of Kleopatra, the KDE keymanager
+    SPDX-FileCopyrightText: 2026 agent <agent@local>
+
+    SPDX-License-Identifier: GPL-2.0-or-later
+*/
+
+//
+// Usage: loadtest_uiserver [--socket <socket> | --kleopatra <kleopatra binary>]
+//                          [--connections <n>] [--requests <n>] [--mix <op=weight,...>]
+//                          [--data <file>] [--signature <file>] [--sender <address>]
+//                          [--recipient <address>] [--seed <n>] [--stats]
+//
+// Opens <n> concurrent connections to the UI server and replays a weighted
+// mix of operations on each of them. With --kleopatra, a Kleopatra instance
+// is started in daemon mode with a throwaway copy of tests/gnupg_home.
+//
+// Prints one line of comma-separated values per operation and one for all
+// operations:
+//   operation,count,errors,ops per second,p50 (ms),p99 (ms),max (ms)
+//
+// Available operations:
+//   getinfo                GETINFO version (no crypto; measures the server overhead)
+//   verify                 VERIFY of a detached OpenPGP signature
+//   encrypt                ENCRYPT to --recipient
+//   sign                   SIGN --detached as --sender (the test keys need a passphrase)
+//   verify_files           VERIFY_FILES of --signature
+//   decrypt_verify_files   DECRYPT_VERIFY_FILES of --signature
+//   select_certificate     SELECT_CERTIFICATE (interactive)
+//
+// The *_FILES and SELECT_CERTIFICATE operations open dialogs, so they are not
+// part of the default mix.
+//
+
+#include <config-kleopatra.h>
+
+#include <assuan.h>
+#include <gpg-error.h>
+
+#include <Libkleo/Hex>
+#include <Libkleo/KleoException>
+
+#include "utils/wsastarter.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace Kleo;
+
+namespace
+{
+
+struct Config {
+    std::string socket;
+    std::string data;
+    std::string signature;
+    std::string sender;
+    std::string recipient;
+    std::string outputDir;
+    unsigned int requests = 0;
+    quint32 seed = 0;
+    std::vector<std::pair<std::string, unsigned int>> mix;
+};
+
+struct Sample {
+    std::string operation;
+    double msecs;
+    bool error;
+};
+
+gpg_error_t collectData(void *opaque, const void *buffer, size_t length)
+{
+    static_cast<std::string *>(opaque)->append(static_cast<const char *>(buffer), length);
+    return 0;
+}
+
+gpg_error_t transact(assuan_context_t ctx, const std::string &line, std::string *data = nullptr)
+{
+    return assuan_transact(ctx, line.c_str(), data ? collectData : nullptr, data, nullptr, nullptr, nullptr, nullptr);
+}
+
+std::string fileArg(const std::string &fileName)
+{
+    return "FILE=" + hexencode(fileName);
+}
+
+// Returns the lines to send to the server for one request of the given operation.
+std::vector<std::string> requestLines(const std::string &op, const Config &cfg, const std::string &output)
+{
+    if (op == "getinfo") {
+        return {"GETINFO version"};
+    }
+    if (op == "verify") {
+        return {"OPTION mode=email",
+                "MESSAGE " + fileArg(cfg.data),
+                "INPUT " + fileArg(cfg.signature),
+                "VERIFY --protocol=OpenPGP --silent"};
+    }
+    if (op == "encrypt") {
+        return {"OPTION mode=email",
+                "RECIPIENT <" + cfg.recipient + '>',
+                "INPUT " + fileArg(cfg.data),
+                "OUTPUT " + fileArg(output),
+                "ENCRYPT --protocol=OpenPGP"};
+    }
+    if (op == "sign") {
+        return {"OPTION mode=email",
+                "SENDER <" + cfg.sender + '>',
+                "INPUT " + fileArg(cfg.data),
+                "OUTPUT " + fileArg(output),
+                "SIGN --detached --protocol=OpenPGP"};
+    }
+    if (op == "verify_files" || op == "decrypt_verify_files") {
+        std::string command = op;
+        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+        return {"OPTION mode=filemanager",
+                "FILE " + hexencode(cfg.signature),
+                command};
+    }
+    if (op == "select_certificate") {
+        return {"SELECT_CERTIFICATE"};
+    }
+    throw Exception(gpg_error(GPG_ERR_INV_ARG), "unknown operation: " + op);
+}
+
+void runConnection(unsigned int id, const Config &cfg, std::vector<Sample> &samples, std::mutex &mutex)
+{
+    assuan_context_t ctx = nullptr;
+    if (const gpg_error_t err = assuan_new(&ctx)) {
+        std::cerr << Exception(err, "assuan_new").what() << std::endl;
+        return;
+    }
+    const std::unique_ptr<std::remove_pointer<assuan_context_t>::type, void (*)(assuan_context_t)> guard(ctx, &assuan_release);
+
+    if (const gpg_error_t err = assuan_socket_connect(ctx, cfg.socket.c_str(), ASSUAN_INVALID_PID, 0)) {
+        std::cerr << "connection " << id << ": " << Exception(err, "assuan_socket_connect").what() << std::endl;
+        const std::lock_guard<std::mutex> lock(mutex);
+        samples.push_back({"connect", 0.0, true});
+        return;
+    }
+
+    unsigned int totalWeight = 0;
+    for (const auto &entry : cfg.mix) {
+        totalWeight += entry.second;
+    }
+    QRandomGenerator random(cfg.seed + id);
+    const std::string output = cfg.outputDir + "/output-" + std::to_string(id);
+
+    std::vector<Sample> mySamples;
+    mySamples.reserve(cfg.requests);
+    for (unsigned int i = 0; i < cfg.requests; ++i) {
+        unsigned int pick = random.bounded(totalWeight);
+        auto it = cfg.mix.cbegin();
+        while (pick >= it->second) {
+            pick -= it->second;
+            ++it;
+        }
+        const std::string &op = it->first;
+        QFile::remove(QFile::decodeName(output.c_str()));
+
+        const auto start = std::chrono::steady_clock::now();
+        gpg_error_t err = 0;
+        for (const std::string &line : requestLines(op, cfg, output)) {
+            if ((err = transact(ctx, line))) {
+                break;
+            }
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        mySamples.push_back({op, elapsed.count(), err != 0});
+        if (err && (gpg_err_code(err) == GPG_ERR_EPIPE || gpg_err_code(err) == GPG_ERR_ASS_CONNECT_FAILED)) {
+            std::cerr << "connection " << id << ": " << gpg_strerror(err) << std::endl;
+            break;
+        }
+    }
+
+    transact(ctx, "BYE");
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    samples.insert(samples.end(), mySamples.cbegin(), mySamples.cend());
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    const auto index = std::min<std::size_t>(sorted.size() - 1, static_cast<std::size_t>(p * sorted.size()));
+    return sorted[index];
+}
+
+void report(const std::string &op, const std::vector<Sample> &samples, double seconds)
+{
+    std::vector<double> latencies;
+    unsigned int errors = 0;
+    for (const Sample &s : samples) {
+        if (op == "all" || s.operation == op) {
+            latencies.push_back(s.msecs);
+            errors += s.error ? 1 : 0;
+        }
+    }
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << op << ',' << latencies.size() << ',' << errors << ','
+              << (seconds > 0 ? latencies.size() / seconds : 0.0) << ','
+              << percentile(latencies, 0.50) << ',' << percentile(latencies, 0.99) << ','
+              << latencies.back() << std::endl;
+}
+
+std::vector<std::pair<std::string, unsigned int>> parseMix(const QString &value)
+{
+    std::vector<std::pair<std::string, unsigned int>> result;
+    const auto parts = value.split(QLatin1Char(','), Qt::SkipEmptyParts);
+    for (const QString &part : parts) {
+        const int pos = part.indexOf(QLatin1Char('='));
+        const std::string op = (pos < 0 ? part : part.left(pos)).trimmed().toStdString();
+        const unsigned int weight = pos < 0 ? 1 : part.mid(pos + 1).toUInt();
+        if (weight > 0) {
+            // validates the name of the operation
+            requestLines(op, Config(), std::string());
+            result.emplace_back(op, weight);
+        }
+    }
+    if (result.empty()) {
+        throw Exception(gpg_error(GPG_ERR_INV_ARG), "empty operation mix");
+    }
+    return result;
+}
+
+void copyDirectory(const QString &source, const QString &target)
+{
+    QDir().mkpath(target);
+    const auto entries = QDir(source).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+    for (const QFileInfo &fi : entries) {
+        const QString targetPath = target + QLatin1Char('/') + fi.fileName();
+        if (fi.isDir()) {
+            copyDirectory(fi.absoluteFilePath(), targetPath);
+        } else if (!QFile::copy(fi.absoluteFilePath(), targetPath)) {
+            throw Exception(gpg_error(GPG_ERR_EIO), QStringLiteral("Could not copy %1").arg(fi.absoluteFilePath()));
+        }
+    }
+}
+
+// Starts Kleopatra in daemon mode with a copy of the test GnuPG home directory
+// and waits until its UI server accepts connections.
+void startKleopatra(QProcess &process, const QString &program, const QString &dir, const std::string &socket)
+{
+    const QString gnupgHome = dir + QStringLiteral("/gnupg_home");
+    copyDirectory(QStringLiteral(KLEO_TEST_GNUPGHOME), gnupgHome);
+    QFile::setPermissions(gnupgHome, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(QStringLiteral("GNUPGHOME"), gnupgHome);
+    env.insert(QStringLiteral("XDG_CONFIG_HOME"), dir + QStringLiteral("/config"));
+    env.insert(QStringLiteral("XDG_DATA_HOME"), dir + QStringLiteral("/data"));
+    process.setProcessEnvironment(env);
+    process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    process.start(program, {QStringLiteral("--daemon"), QStringLiteral("--uiserver-socket"), QFile::decodeName(socket.c_str())});
+    if (!process.waitForStarted()) {
+        throw Exception(gpg_error(GPG_ERR_GENERAL), process.errorString());
+    }
+
+    for (int i = 0; i < 600; ++i) {
+        assuan_context_t ctx = nullptr;
+        if (assuan_new(&ctx) == 0) {
+            const gpg_error_t err = assuan_socket_connect(ctx, socket.c_str(), ASSUAN_INVALID_PID, 0);
+            if (!err) {
+                transact(ctx, "BYE");
+            }
+            assuan_release(ctx);
+            if (!err) {
+                return;
+            }
+        }
+        if (process.state() != QProcess::Running) {
+            throw Exception(gpg_error(GPG_ERR_GENERAL), "Kleopatra exited before its UI server was ready");
+        }
+        QThread::msleep(100);
+    }
+    throw Exception(gpg_error(GPG_ERR_TIMEOUT), "Timed out waiting for the UI server");
+}
+
+std::string serverStatistics(const std::string &socket)
+{
+    assuan_context_t ctx = nullptr;
+    if (assuan_new(&ctx)) {
+        return {};
+    }
+    std::string data;
+    if (!assuan_socket_connect(ctx, socket.c_str(), ASSUAN_INVALID_PID, 0)) {
+        transact(ctx, "GETINFO stats", &data);
+        transact(ctx, "BYE");
+    }
+    assuan_release(ctx);
+    return data;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    const Kleo::WSAStarter _wsastarter;
+    QCoreApplication app(argc, argv);
+
+    assuan_set_gpg_err_source(GPG_ERR_SOURCE_DEFAULT);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({QStringLiteral("socket"), QStringLiteral("Socket of a running UI server."), QStringLiteral("socket")});
+    parser.addOption({QStringLiteral("kleopatra"), QStringLiteral("Start this Kleopatra binary with a throwaway copy of the test GnuPG home."), QStringLiteral("binary")});
+    parser.addOption({QStringLiteral("connections"), QStringLiteral("Number of concurrent connections."), QStringLiteral("n"), QStringLiteral("4")});
+    parser.addOption({QStringLiteral("requests"), QStringLiteral("Number of requests per connection."), QStringLiteral("n"), QStringLiteral("100")});
+    parser.addOption({QStringLiteral("mix"), QStringLiteral("Comma-separated list of operation=weight."), QStringLiteral("mix"), QStringLiteral("getinfo=1,verify=4,encrypt=2")});
+    parser.addOption({QStringLiteral("data"), QStringLiteral("Data to sign, encrypt or verify."), QStringLiteral("file"), QStringLiteral(KLEO_TEST_DATADIR "/test.data")});
+    parser.addOption({QStringLiteral("signature"), QStringLiteral("Detached signature of the data."), QStringLiteral("file"), QStringLiteral(KLEO_TEST_DATADIR "/test.data.sig")});
+    parser.addOption({QStringLiteral("sender"), QStringLiteral("Address of the signing key."), QStringLiteral("address"), QStringLiteral("foo@bar.com")});
+    parser.addOption({QStringLiteral("recipient"), QStringLiteral("Address of the encryption key."), QStringLiteral("address"), QStringLiteral("foo@bar.com")});
+    parser.addOption({QStringLiteral("seed"), QStringLiteral("Seed for picking the operations."), QStringLiteral("n"), QStringLiteral("1")});
+    parser.addOption({QStringLiteral("stats"), QStringLiteral("Print the server's GETINFO stats at the end.")});
+    parser.process(app);
+
+    if (parser.isSet(QStringLiteral("socket")) == parser.isSet(QStringLiteral("kleopatra"))) {
+        std::cerr << "Exactly one of --socket and --kleopatra is required" << std::endl;
+        return 1;
+    }
+
+    const QTemporaryDir tmpDir;
+    if (!tmpDir.isValid()) {
+        std::cerr << "Could not create temporary directory" << std::endl;
+        return 1;
+    }
+
+    Config cfg;
+    QProcess kleopatra;
+    try {
+        cfg.data = QFileInfo(parser.value(QStringLiteral("data"))).absoluteFilePath().toStdString();
+        cfg.signature = QFileInfo(parser.value(QStringLiteral("signature"))).absoluteFilePath().toStdString();
+        cfg.sender = parser.value(QStringLiteral("sender")).toStdString();
+        cfg.recipient = parser.value(QStringLiteral("recipient")).toStdString();
+        cfg.outputDir = tmpDir.path().toStdString();
+        cfg.requests = parser.value(QStringLiteral("requests")).toUInt();
+        cfg.seed = parser.value(QStringLiteral("seed")).toUInt();
+        cfg.mix = parseMix(parser.value(QStringLiteral("mix")));
+
+        if (parser.isSet(QStringLiteral("kleopatra"))) {
+            cfg.socket = tmpDir.filePath(QStringLiteral("S.uiserver")).toStdString();
+            startKleopatra(kleopatra, parser.value(QStringLiteral("kleopatra")), tmpDir.path(), cfg.socket);
+        } else {
+            cfg.socket = parser.value(QStringLiteral("socket")).toStdString();
+        }
+    } catch (const Exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    const unsigned int numConnections = qMax(parser.value(QStringLiteral("connections")).toUInt(), 1u);
+    std::vector<Sample> samples;
+    std::mutex mutex;
+    std::vector<std::thread> threads;
+    threads.reserve(numConnections);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < numConnections; ++i) {
+        threads.emplace_back(runConnection, i, std::cref(cfg), std::ref(samples), std::ref(mutex));
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "operation,count,errors,ops_per_s,p50_ms,p99_ms,max_ms" << std::endl;
+    report("connect", samples, elapsed.count());
+    for (const auto &entry : cfg.mix) {
+        report(entry.first, samples, elapsed.count());
+    }
+    report("all", samples, elapsed.count());
+
+    if (parser.isSet(QStringLiteral("stats"))) {
+        std::cout << std::endl << serverStatistics(cfg.socket);
+    }
+
+    if (kleopatra.state() != QProcess::NotRunning) {
+        kleopatra.terminate();
+        if (!kleopatra.waitForFinished(5000)) {
+            kleopatra.kill();
+            kleopatra.waitForFinished();
+        }
+    }
+    return 0;
+}